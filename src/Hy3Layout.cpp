@@ -1,11 +1,16 @@
 #include "globals.hpp"
 #include "Hy3Layout.hpp"
-#include "SelectionHook.hpp"
+#include "TreeEvents.hpp"
+#include "TreeSnapshot.hpp"
+#include "core/Ratios.hpp"
+#include "core/Stats.hpp"
+#include "core/Trace.hpp"
 
 #include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/plugins/PluginAPI.hpp>
-#include <iostream>
 
+#include <cmath>
+#include <optional>
 #include <sstream>
 
 void errorNotif() {
@@ -17,505 +22,519 @@ void errorNotif() {
 	});
 }
 
-Hy3GroupData::Hy3GroupData(Hy3GroupLayout layout): layout(layout) {}
+Hy3Layout::Hy3Layout(): Hy3Tree(static_cast<Hy3TreeBackend&>(*this)) {
+	pixman_region32_init(&this->pass_damage);
+}
 
-Hy3NodeData::Hy3NodeData(): Hy3NodeData((CWindow*)nullptr) {}
+Hy3Layout::~Hy3Layout() {
+	for (auto& entry: this->transaction) {
+		if (entry.waiting) wl_list_remove(&entry.commit_listener.link);
+	}
 
-Hy3NodeData::Hy3NodeData(CWindow *window): type(Hy3NodeData::Window) {
-	this->as_window = window;
-}
+	if (this->transaction_timer != nullptr) wl_event_source_remove(this->transaction_timer);
 
-Hy3NodeData::Hy3NodeData(Hy3GroupData group): type(Hy3NodeData::Group) {
-	new(&this->as_group) Hy3GroupData(std::move(group));
+	pixman_region32_fini(&this->pass_damage);
 }
 
-Hy3NodeData::Hy3NodeData(Hy3GroupLayout layout): Hy3NodeData(Hy3GroupData(layout)) {}
-
-Hy3NodeData::~Hy3NodeData() {
-	switch (this->type) {
-	case Hy3NodeData::Window:
-		break;
-	case Hy3NodeData::Group:
-		this->as_group.~Hy3GroupData();
+void Hy3Layout::beginPass() {
+	// nodes of closed windows are gone before the pass does anything
+	if (this->pass_depth++ == 0 && this->invalid_nodes != 0) this->purgeInvalidNodes();
+}
 
-		// who ever thought calling the dtor after a move was a good idea?
-		this->type = Hy3NodeData::Window;
-		break;
+void Hy3Layout::onWindowClosed(CWindow* window) {
+	for (auto& node: this->nodes) {
+		if (node.data.type == Hy3NodeData::Window && node.data.as_window == toHandle(window) && node.valid) {
+			node.valid = false;
+			this->invalid_nodes++;
+		}
 	}
 }
 
-Hy3NodeData::Hy3NodeData(const Hy3NodeData& from): type(from.type) {
-	Debug::log(LOG, "Copy CTor type matches? %d is group? %d", this->type == from.type, this->type == Hy3NodeData::Group);
-	switch (from.type) {
-	case Hy3NodeData::Window:
-		this->as_window = from.as_window;
-		break;
-	case Hy3NodeData::Group:
-		new(&this->as_group) Hy3GroupData(from.as_group);
-		break;
-	}
+void Hy3Layout::onWorkspaceDestroyed(int workspace) {
+	// the id may be taken by a new workspace, which must not inherit any of this
+	this->histories.erase(workspace);
+	this->workspace_indexes.erase(workspace);
+	this->stale_indexes.erase(workspace);
+	this->hibernated_workspaces.erase(workspace);
 }
 
-Hy3NodeData::Hy3NodeData(Hy3NodeData&& from): type(from.type) {
-	Debug::log(LOG, "Move CTor type matches? %d is group? %d", this->type == from.type, this->type == Hy3NodeData::Group);
-	switch (from.type) {
-	case Hy3NodeData::Window:
-		this->as_window = from.as_window;
-		break;
-	case Hy3NodeData::Group:
-		new(&this->as_group) Hy3GroupData(std::move(from.as_group));
-		break;
+void Hy3Layout::purgeInvalidNodes() {
+	trace::Span span("purgeInvalidNodes");
+	this->invalid_nodes = 0;
+
+	std::vector<Hy3Node*> invalid;
+	for (auto& node: this->nodes) {
+		if (!node.valid) invalid.push_back(&node);
+	}
+
+	for (auto* node: invalid) {
+		Debug::log(LOG, "Purging node %p of closed window %p", node, node->data.as_window);
+		this->removeWindowNode(node);
 	}
 }
 
-Hy3NodeData& Hy3NodeData::operator=(const Hy3NodeData& from) {
-	Debug::log(LOG, "operator= type matches? %d is group? %d", this->type == from.type, this->type == Hy3NodeData::Group);
-	if (this->type == Hy3NodeData::Group) {
-		this->as_group.~Hy3GroupData();
+void Hy3Layout::endPass() {
+	if (this->pass_depth == 1) {
+		// still inside the pass so relayouts from normalizing are part of it
+		if (this->normalize_queued) this->normalizeTrees();
+		this->flushTransaction();
 	}
 
-	this->type = from.type;
+	if (--this->pass_depth != 0) return;
 
-	switch (this->type) {
-	case Hy3NodeData::Window:
-		this->as_window = from.as_window;
-		break;
-	case Hy3NodeData::Group:
-		new(&this->as_group) Hy3GroupData(from.as_group);
-		break;
+	stats::count(stats::Counter::LayoutPasses);
+	stats::setNodeCount(this->nodes.size());
+
+	auto events_posted = tree_events::flush();
+
+	if (events_posted || this->tree_changed || !this->dirty_workspaces.empty()) {
+		this->updateSelectedWindows();
+		tree_snapshot::publish(*this);
+		this->tree_changed = false;
 	}
 
-	return *this;
+	this->dirty_workspaces.clear();
+
+	// submitted as a single region, the renderer splits it between monitors
+	if (pixman_region32_not_empty(&this->pass_damage)) {
+		g_pHyprRenderer->damageRegion(&this->pass_damage);
+		stats::count(stats::Counter::DamageCalls);
+		pixman_region32_clear(&this->pass_damage);
+	}
 }
 
-Hy3NodeData& Hy3NodeData::operator=(CWindow* window) {
-	*this = Hy3NodeData(window);
+void Hy3Layout::markWorkspaceDirty(int workspace) {
+	this->dirty_workspaces.insert(workspace);
+	this->stale_indexes.insert(workspace);
+}
 
-	return *this;
+void Hy3Layout::focusWindow(Hy3WindowHandle window) {
+	// applied once the batch is done, see runBatch
+	if (this->batch_running) return;
+	g_pCompositor->focusWindow(toWindow(window));
 }
 
-Hy3NodeData& Hy3NodeData::operator=(Hy3GroupLayout layout) {
-	*this = Hy3NodeData(layout);
+void Hy3Layout::raiseWindow(Hy3WindowHandle window) {
+	g_pCompositor->moveWindowToTop(toWindow(window));
+}
 
-	return *this;
+void Hy3Layout::treeChanged(Hy3TreeChange change, Hy3Node* node) {
+	switch (change) {
+	case Hy3TreeChange::Created:
+		tree_events::created(node);
+		break;
+	case Hy3TreeChange::Removed:
+		tree_events::removed(node);
+		break;
+	case Hy3TreeChange::Moved:
+		tree_events::moved(node);
+		break;
+	case Hy3TreeChange::LayoutChanged:
+		tree_events::layoutChanged(node);
+		break;
+	case Hy3TreeChange::RatioChanged:
+		tree_events::ratioChanged(node);
+		break;
+	case Hy3TreeChange::FocusChanged:
+		this->tree_changed = true;
+		tree_events::focusChanged(node);
+		break;
+	}
 }
 
-bool Hy3NodeData::operator==(const Hy3NodeData& rhs) const {
-	return this == &rhs;
+Hy3TreeSettings Hy3Layout::getTreeSettings() {
+	static const auto* gaps_in = &HyprlandAPI::getConfigValue(PHANDLE, "general:gaps_in")->intValue;
+	static const auto* gaps_out = &HyprlandAPI::getConfigValue(PHANDLE, "general:gaps_out")->intValue;
+	static const auto* accordion_collapsed_size = &HyprlandAPI::getConfigValue(PHANDLE, "plugin:hy3:accordion_collapsed_size")->intValue;
+
+	return Hy3TreeSettings {
+		.gaps_in = (int) *gaps_in,
+		.gaps_out = (int) *gaps_out,
+		.accordion_collapsed_size = (int) *accordion_collapsed_size,
+	};
 }
 
-bool Hy3Node::operator==(const Hy3Node& rhs) const {
-	return this->data == rhs.data;
+void Hy3Layout::log(Hy3LogLevel level, const std::string& message) {
+	switch (level) {
+	case Hy3LogLevel::Log:
+		Debug::log(LOG, "%s", message.c_str());
+		break;
+	case Hy3LogLevel::Error:
+		Debug::log(ERR, "%s", message.c_str());
+		break;
+	case Hy3LogLevel::Critical:
+		Debug::log(ERR, "%s", message.c_str());
+		errorNotif();
+		break;
+	}
 }
 
-void Hy3Node::recalcSizePosRecursive(bool force) {
-	if (this->data.type != Hy3NodeData::Group) {
-		this->layout->applyNodeDataToWindow(this, force);
-		return;
+static void collectWindows(Hy3Node* node, std::unordered_set<CWindow*>& windows) {
+	switch (node->data.type) {
+	case Hy3NodeData::Window:
+		if (!node->placeholder) windows.insert(toWindow(node->data.as_window));
+		break;
+	case Hy3NodeData::Group:
+		for (auto* child: node->data.as_group.children) {
+			collectWindows(child, windows);
+		}
 	}
+}
 
-	auto* group = &this->data.as_group;
+void Hy3Layout::updateSelectedWindows() {
+	trace::Span span("updateSelectedWindows");
+	std::unordered_set<CWindow*> selected;
 
-	if (group->children.size() == 1 && this->parent != nullptr) {
-		auto child = group->children.front();
+	for (auto& node: this->nodes) {
+		if (node.parent != nullptr || node.data.type != Hy3NodeData::Group) continue;
+		if (node.data.as_group.focused_child == nullptr) continue;
 
-		if (child == this) {
-			Debug::log(ERR, "a group (%p) has become its own child", this);
-			errorNotif();
+		// only a focused group is drawn as selected, a focused window is already the active window
+		auto* focused = node.getFocusedNode();
+		if (focused != nullptr && focused != &node && focused->data.type == Hy3NodeData::Group) {
+			collectWindows(focused, selected);
 		}
+	}
 
-		double distortOut;
-		double distortIn;
+	if (selected == this->selected_windows) return;
+	std::swap(selected, this->selected_windows);
 
-		const auto* gaps_in     = &g_pConfigManager->getConfigValuePtr("general:gaps_in")->intValue;
-		const auto* gaps_out    = &g_pConfigManager->getConfigValuePtr("general:gaps_out")->intValue;
+	// selected now holds the previous set
+	auto update = [](CWindow* window) {
+		if (window->m_bIsMapped) g_pCompositor->updateWindowAnimatedDecorationValues(window);
+	};
 
-		if (gaps_in > gaps_out) {
-			distortOut = *gaps_out - 1.0;
-		} else {
-			distortOut = *gaps_in - 1.0;
-		}
+	for (auto* window: selected) {
+		if (!this->selected_windows.contains(window)) update(window);
+	}
 
-		if (distortOut < 0) distortOut = 0.0;
+	for (auto* window: this->selected_windows) {
+		if (!selected.contains(window)) update(window);
+	}
+}
 
-		distortIn = *gaps_in * 2;
+void Hy3Layout::stageWindowGeometry(CWindow* window, const Vector2D& position, const Vector2D& size, bool warp) {
+	auto entry = std::find_if(this->transaction.begin(), this->transaction.end(), [&](auto& entry) {
+		return entry.window == window;
+	});
 
-		switch (group->layout) {
-		case Hy3GroupLayout::SplitH:
-			child->position.x = this->position.x - distortOut;
-			child->size.x = this->size.x - distortIn;
-			child->position.y = this->position.y;
-			child->size.y = this->size.y;
-			break;
-		case Hy3GroupLayout::SplitV:
-			child->position.y = this->position.y - distortOut;
-			child->size.y = this->size.y - distortIn;
-			child->position.x = this->position.x;
-			child->size.x = this->size.x;
-		case Hy3GroupLayout::Tabbed:
-			// TODO
-			break;
-		}
+	if (entry == this->transaction.end()) {
+		if (window->m_vRealPosition.goalv() == position && window->m_vRealSize.goalv() == size && !warp) return;
 
-		child->recalcSizePosRecursive(force);
-		return;
+		entry = this->transaction.emplace(this->transaction.end());
+		entry->layout = this;
+		entry->window = window;
+		entry->configured_size = window->m_vRealSize.goalv();
+		wl_list_init(&entry->commit_listener.link);
 	}
 
-	int constraint;
-	switch (group->layout) {
-	case Hy3GroupLayout::SplitH:
-		constraint = this->size.x;
-		break;
-	case Hy3GroupLayout::SplitV:
-		constraint = this->size.y;
-		break;
-	case Hy3GroupLayout::Tabbed:
-		break;
-	}
+	// restaging within a pass only replaces the target, nothing is sent yet
+	entry->position = position;
+	entry->size = size;
+	entry->warp |= warp;
+}
 
-	double ratio_mul = group->layout != Hy3GroupLayout::Tabbed ? group->children.empty() ? 0 : constraint / group->children.size() : 0;
+void Hy3Layout::flushTransaction() {
+	static const auto* timeout = &HyprlandAPI::getConfigValue(PHANDLE, "plugin:hy3:transaction_timeout")->intValue;
 
-	double offset = 0;
+	if (this->transaction.empty()) return;
 
-	for(auto child: group->children) {
-		switch (group->layout) {
-		case Hy3GroupLayout::SplitH:
-			child->position.x = this->position.x + offset;
-			child->size.x = child->size_ratio * ratio_mul;
-			offset += child->size.x;
-			child->position.y = this->position.y;
-			child->size.y = this->size.y;
-			break;
-		case Hy3GroupLayout::SplitV:
-			child->position.y = this->position.y + offset;
-			child->size.y = child->size_ratio * ratio_mul;
-			offset += child->size.y;
-			child->position.x = this->position.x;
-			child->size.x = this->size.x;
-			break;
-		case Hy3GroupLayout::Tabbed:
-			// TODO: tab bars
-			child->position = this->position;
-			child->size = this->size;
-			break;
-		}
+	for (auto entry = this->transaction.begin(); entry != this->transaction.end();) {
+		auto* window = entry->window;
 
-		child->recalcSizePosRecursive(force);
-	}
-}
+		// only a new size needs a configure and a new buffer from the client
+		if (entry->size != entry->configured_size) {
+			Debug::log(LOG, "Set size (%f %f)", entry->size.x, entry->size.y);
+			g_pXWaylandManager->setWindowSize(window, entry->size);
+			stats::count(stats::Counter::ConfiguresSent);
+			entry->configured_size = entry->size;
 
-void Hy3Node::markFocused() {
-	Hy3Node* node = this;
+			auto* surface = g_pXWaylandManager->getWindowSurface(window);
 
-	// undo decos for root focus
-	auto* root = node;
-	while (root->parent != nullptr) root = root->parent;
-	auto* oldfocus = root->getFocusedNode();
+			if (*timeout > 0 && surface != nullptr) {
+				if (!window->m_bIsX11) entry->serial = window->m_uSurface.xdg->scheduled_serial;
 
-	// update focus
-	if (this->data.type == Hy3NodeData::Group) {
-		this->data.as_group.group_focused = true;
-		this->data.as_group.focused_child = nullptr;
-	}
+				if (!entry->waiting) {
+					entry->waiting = true;
+					entry->commit_listener.notify = &Hy3Layout::onTransactionCommit;
+					wl_signal_add(&surface->events.commit, &entry->commit_listener);
+					this->transaction_waiting++;
+				}
+			}
+		}
 
-	while (node->parent != nullptr) {
-		node->parent->data.as_group.focused_child = node;
-		node->parent->data.as_group.group_focused = false;
-		node = node->parent;
-	}
+		// staged back to where the window already is
+		if (!entry->waiting && !entry->warp
+				&& entry->position == window->m_vRealPosition.goalv()
+				&& entry->size == window->m_vRealSize.goalv())
+		{
+			entry = this->transaction.erase(entry);
+			continue;
+		}
 
-	if (oldfocus != nullptr) {
-		oldfocus->updateDecos();
+		entry++;
 	}
-}
 
-void Hy3Node::focus() {
-	this->markFocused();
+	if (this->transaction.empty()) return;
 
-	switch (this->data.type) {
-	case Hy3NodeData::Window:
-		g_pCompositor->focusWindow(this->data.as_window);
-		break;
-	case Hy3NodeData::Group:
-		g_pCompositor->focusWindow(nullptr);
-		this->raiseToTop();
-		break;
+	if (this->transaction_waiting == 0) {
+		this->applyTransaction();
+	} else if (this->transaction_timer == nullptr) {
+		this->transaction_timer = wl_event_loop_add_timer(g_pCompositor->m_sWLEventLoop, &Hy3Layout::onTransactionTimeout, this);
+		wl_event_source_timer_update(this->transaction_timer, *timeout);
 	}
 }
 
-void Hy3Node::raiseToTop() {
-	switch (this->data.type) {
-	case Hy3NodeData::Window:
-		g_pCompositor->moveWindowToTop(this->data.as_window);
-		break;
-	case Hy3NodeData::Group:
-		for (auto* child: this->data.as_group.children) {
-			child->raiseToTop();
-		}
-		break;
-	}
-}
+void Hy3Layout::applyTransaction() {
+	trace::Span span("applyTransaction");
+	Hy3TreePass pass(this);
 
-Hy3Node* Hy3Node::getFocusedNode() {
-	switch (this->data.type) {
-	case Hy3NodeData::Window:
-		return this;
-	case Hy3NodeData::Group:
-		if (this->data.as_group.focused_child == nullptr || this->data.as_group.group_focused) {
-			return this;
-		} else {
-			return this->data.as_group.focused_child->getFocusedNode();
-		}
+	if (this->transaction_timer != nullptr) {
+		wl_event_source_remove(this->transaction_timer);
+		this->transaction_timer = nullptr;
 	}
-}
 
-bool Hy3Node::swallowGroups(Hy3Node* into) {
-	if (into == nullptr
-			|| into->data.type != Hy3NodeData::Group
-			|| into->data.as_group.children.size() != 1)
-		return false;
+	auto entries = std::move(this->transaction);
+	this->transaction.clear();
+	this->transaction_waiting = 0;
 
-	auto* child = into->data.as_group.children.front();
+	for (auto& entry: entries) {
+		if (entry.waiting) wl_list_remove(&entry.commit_listener.link);
 
-	// a lot of segfaulting happens once the assumption that the root node is a group is wrong.
-	if (into->parent == nullptr && child->data.type != Hy3NodeData::Group) return false;
+		auto* window = entry.window;
+		auto moved = window->m_vRealPosition.goalv() != entry.position;
 
-	Debug::log(LOG, "Swallowing %p into %p", child, into);
-	Hy3Node::swapData(*into, *child);
-	into->layout->nodes.remove(*child);
+		this->damageWindowMove(window, entry.position, entry.size);
+		window->m_vRealPosition = entry.position;
+		window->m_vRealSize = entry.size;
 
-	return true;
-}
+		if (entry.warp) {
+			window->m_vRealPosition.warp();
+			window->m_vRealSize.warp();
+		}
 
-Hy3Node* Hy3Node::removeFromParentRecursive() {
-	Hy3Node* parent = this;
+		// x11 clients are configured with their position as well
+		if (moved && window->m_bIsX11) g_pXWaylandManager->setWindowSize(window, entry.size);
 
-	Debug::log(LOG, "Recursively removing parent nodes of %p", parent);
+		window->updateWindowDecos();
+	}
+}
 
-	while (parent != nullptr) {
-		if (parent->parent == nullptr) {
-			Debug::log(ERR, "* UAF DEBUGGING - %p's parent is null, its the root group", parent);
+void Hy3Layout::dropTransactionWindow(CWindow* window) {
+	for (auto entry = this->transaction.begin(); entry != this->transaction.end(); entry++) {
+		if (entry->window != window) continue;
 
-			if (parent == this) {
-				Debug::log(ERR, "* UAF DEBUGGING - returning nullptr as this == root group");
-			} else {
-				Debug::log(ERR, "* UAF DEBUGGING - deallocing %p and returning nullptr", parent);
-				parent->layout->nodes.remove(*parent);
-			}
-			return nullptr;
+		if (entry->waiting) {
+			wl_list_remove(&entry->commit_listener.link);
+			this->transaction_waiting--;
 		}
 
-		auto* child = parent;
-		parent = parent->parent;
-		auto& group = parent->data.as_group;
+		this->transaction.erase(entry);
+		return;
+	}
+}
 
-		if (group.children.size() > 2) {
-			auto iter = std::find(group.children.begin(), group.children.end(), child);
+void Hy3Layout::onTransactionCommit(wl_listener* listener, void* data) {
+	Hy3TransactionEntry* entry = wl_container_of(listener, entry, commit_listener);
+	auto* layout = entry->layout;
+	auto* window = entry->window;
 
-			group.group_focused = false;
-			if (iter == group.children.begin()) {
-				group.focused_child = *std::next(iter);
-			} else {
-				group.focused_child = *std::prev(iter);
-			}
-		}
+	// frames committed before the client acked the configure are still at the old size
+	if (window->m_bIsX11) {
+		auto* surface = (wlr_surface*) data;
+		if (surface->current.width != (int) std::round(entry->size.x) || surface->current.height != (int) std::round(entry->size.y)) return;
+	} else if ((int32_t) (window->m_uSurface.xdg->current.configure_serial - entry->serial) < 0) {
+		return;
+	}
 
-		if (!group.children.remove(child)) {
-			Debug::log(ERR, "Was unable to remove child node %p from parent %p. Child likely has a false parent pointer.", child, parent);
-			errorNotif();
-			return nullptr;
-		}
+	wl_list_remove(&entry->commit_listener.link);
+	wl_list_init(&entry->commit_listener.link);
+	entry->waiting = false;
 
-		group.group_focused = false;
-		if (group.children.size() == 1) {
-			group.focused_child = group.children.front();
-		}
+	if (--layout->transaction_waiting == 0) layout->applyTransaction();
+}
 
-		auto child_size_ratio = child->size_ratio;
-		if (child != this) {
-			parent->layout->nodes.remove(*child);
-		} else {
-			child->parent = nullptr;
-		}
+int Hy3Layout::onTransactionTimeout(void* data) {
+	auto* layout = (Hy3Layout*) data;
+	Debug::log(LOG, "Transaction timed out with %d clients yet to commit", (int) layout->transaction_waiting);
 
-		if (!group.children.empty()) {
-			auto child_count = group.children.size();
-			if (std::find(group.children.begin(), group.children.end(), this) != group.children.end()) {
-				child_count -= 1;
-			}
+	layout->applyTransaction();
+	return 0;
+}
 
-			auto splitmod = -((1.0 - child_size_ratio) / child_count);
+void Hy3Layout::damageWindowMove(CWindow* window, const Vector2D& position, const Vector2D& size) {
+	auto current_pos = window->m_vRealPosition.vec();
+	auto current_size = window->m_vRealSize.vec();
+	if (current_pos == position && current_size == size) return;
+
+	// borders and decorations extend past the window by the same amount after moving
+	auto box = window->getFullWindowBoundingBox();
+	auto extents_tl = current_pos - Vector2D(box.x, box.y);
+	auto extents_br = Vector2D(box.x + box.width, box.y + box.height) - (current_pos + current_size);
+
+	auto new_tl = position - extents_tl;
+	auto new_br = position + size + extents_br;
+
+	pixman_region32_union_rect(&this->pass_damage, &this->pass_damage, box.x, box.y, box.width, box.height);
+	pixman_region32_union_rect(
+		&this->pass_damage,
+		&this->pass_damage,
+		std::floor(new_tl.x),
+		std::floor(new_tl.y),
+		std::ceil(new_br.x - std::floor(new_tl.x)),
+		std::ceil(new_br.y - std::floor(new_tl.y))
+	);
+}
+
+// collect windows that are currently onscreen, skipping unfocused tabs
+static void collectVisibleWindows(Hy3Node* node, std::vector<Hy3Node*>& out) {
+	switch (node->data.type) {
+	case Hy3NodeData::Window:
+		if (!node->placeholder) out.push_back(node);
+		break;
+	case Hy3NodeData::Group: {
+		auto& group = node->data.as_group;
 
+		if (group.layout == Hy3GroupLayout::Tabbed) {
+			if (group.children.empty()) break;
+			auto* visible = group.focused_child != nullptr ? group.focused_child : group.children.front();
+			collectVisibleWindows(visible, out);
+		} else {
 			for (auto* child: group.children) {
-				child->size_ratio += splitmod;
+				collectVisibleWindows(child, out);
 			}
-
-			break;
 		}
+	} break;
 	}
-
-	return parent;
 }
 
-Hy3Node* Hy3Node::intoGroup(Hy3GroupLayout layout) {
-	this->layout->nodes.push_back({
-		.parent = this,
-		.data = layout,
-		.workspace_id = this->workspace_id,
-		.layout = this->layout,
-	});
-
-	auto* node = &this->layout->nodes.back();
-	swapData(*this, *node);
-
-	this->data = layout;
-	this->data.as_group.children.push_back(node);
-	this->data.as_group.group_focused = false;
-	this->data.as_group.focused_child = node;
-	this->recalcSizePosRecursive();
-
-	return node;
+static hy3core::Rect nodeRect(Hy3Node* node) {
+	return {node->position.x, node->position.y, node->size.x, node->size.y};
 }
 
-bool Hy3GroupData::hasChild(Hy3Node* node) {
-	Debug::log(LOG, "Searching for child %p of %p", this, node);
-	for (auto child: this->children) {
-		if (child == node) return true;
-
-		if (child->data.type == Hy3NodeData::Group) {
-			if (child->data.as_group.hasChild(node)) return true;
-		}
+void Hy3Layout::rebuildWorkspaceIndex(int workspace) {
+	auto* root = this->getWorkspaceRootGroup(workspace);
+	if (root == nullptr) {
+		this->workspace_indexes.erase(workspace);
+		return;
 	}
 
-	return false;
-}
+	auto& index = this->workspace_indexes[workspace];
+	index.windows.clear();
+	index.items.clear();
+	collectVisibleWindows(root, index.windows);
 
-void Hy3Node::swapData(Hy3Node& a, Hy3Node& b) {
-	Hy3NodeData aData = std::move(a.data);
-	a.data = b.data;
-	b.data = aData;
+	std::vector<hy3core::Rect> rects;
+	rects.reserve(index.windows.size());
+	index.items.reserve(index.windows.size());
 
-	if (a.data.type == Hy3NodeData::Group) {
-		for (auto child: a.data.as_group.children) {
-			child->parent = &a;
-		}
+	for (int i = 0; i < (int) index.windows.size(); i++) {
+		rects.push_back(nodeRect(index.windows[i]));
+		index.items[index.windows[i]] = i;
 	}
 
-	if (b.data.type == Hy3NodeData::Group) {
-		for (auto child: b.data.as_group.children) {
-			child->parent = &b;
-		}
-	}
+	index.spatial.build(nodeRect(root), std::move(rects));
 }
 
-void Hy3Node::updateDecos() {
-	switch (this->data.type) {
-	case Hy3NodeData::Window:
-		if (this->data.as_window->m_bIsMapped)
-			g_pCompositor->updateWindowAnimatedDecorationValues(this->data.as_window);
-		break;
-	case Hy3NodeData::Group:
-	  for (auto* child: this->data.as_group.children) {
-			child->updateDecos();
-		}
-	}
+Hy3WorkspaceIndex* Hy3Layout::getWorkspaceIndex(int workspace) {
+	if (this->stale_indexes.erase(workspace) != 0) this->rebuildWorkspaceIndex(workspace);
+
+	auto index = this->workspace_indexes.find(workspace);
+	return index == this->workspace_indexes.end() ? nullptr : &index->second;
 }
 
-int Hy3Layout::getWorkspaceNodeCount(const int& id) {
-	int count = 0;
+Hy3Node* Hy3Layout::getNodeAtFromIndex(int workspace, const Vector2D& pos) {
+	// geometry is still changing until the end of the pass
+	if (this->dirty_workspaces.contains(workspace)) return nullptr;
 
-	for (auto& node: this->nodes) {
-		if (node.workspace_id == id && node.valid) count++;
-	}
+	auto* index = this->getWorkspaceIndex(workspace);
+	if (index == nullptr) return nullptr;
 
-	return count;
+	auto item = index->spatial.itemAt(pos.x, pos.y);
+	return item == -1 ? nullptr : index->windows[item];
 }
 
-Hy3Node* Hy3Layout::getNodeFromWindow(CWindow* window) {
-	for (auto& node: this->nodes) {
-		if (node.data.type == Hy3NodeData::Window && node.data.as_window == window) {
-			return &node;
-		}
-	}
+Hy3Node* Hy3Layout::getNeighborFromIndex(Hy3Node* node, ShiftDirection direction) {
+	auto* index = this->getWorkspaceIndex(node->getWorkspace());
+	if (index == nullptr) return nullptr;
 
-	return nullptr;
+	auto item = index->items.find(node);
+	if (item == index->items.end()) return nullptr;
+
+	auto neighbor = index->spatial.neighbor(item->second, direction);
+	return neighbor == -1 ? nullptr : index->windows[neighbor];
 }
 
-Hy3Node* Hy3Layout::getWorkspaceRootGroup(const int& id) {
-	for (auto& node: this->nodes) {
-		if (node.workspace_id == id && node.parent == nullptr && node.data.type == Hy3NodeData::Group) {
-			return &node;
-		}
-	}
+Hy3Node* Hy3Layout::getEdgeWindowFromIndex(int workspace, ShiftDirection edge, double along) {
+	auto* index = this->getWorkspaceIndex(workspace);
+	if (index == nullptr) return nullptr;
 
-	return nullptr;
+	auto item = index->spatial.edgeItemNear(edge, along);
+	return item == -1 ? nullptr : index->windows[item];
 }
 
-Hy3Node* Hy3Layout::getWorkspaceFocusedNode(const int& id) {
-	auto* rootNode = this->getWorkspaceRootGroup(id);
-	if (rootNode == nullptr) return nullptr;
-	return rootNode->getFocusedNode();
+// every tile of a workspace is covered by a window fullscreened over the whole monitor
+static bool isFullscreenOccluded(int workspace_id) {
+	auto* workspace = g_pCompositor->getWorkspaceByID(workspace_id);
+	return workspace != nullptr && workspace->m_bHasFullscreenWindow && workspace->m_efFullscreenMode == FULLSCREEN_FULL;
 }
 
 void Hy3Layout::applyNodeDataToWindow(Hy3Node* node, bool force) {
 	if (node->data.type != Hy3NodeData::Window) return;
-	CWindow* window = node->data.as_window;
+	trace::Span span("applyNodeDataToWindow");
+	Hy3TreePass pass(this);
+
+	CWindow* window = toWindow(node->data.as_window);
+	auto workspace = node->getWorkspace();
 
 	CMonitor* monitor = nullptr;
 
-	if (g_pCompositor->isWorkspaceSpecial(node->workspace_id)) {
+	if (g_pCompositor->isWorkspaceSpecial(workspace)) {
 		for (auto& m: g_pCompositor->m_vMonitors) {
-			if (m->specialWorkspaceID == node->workspace_id) {
+			if (m->specialWorkspaceID == workspace) {
 				monitor = m.get();
 				break;
 			}
 		}
 	} else {
-		monitor = g_pCompositor->getMonitorFromID(g_pCompositor->getWorkspaceByID(node->workspace_id)->m_iMonitorID);
+		monitor = g_pCompositor->getMonitorFromID(g_pCompositor->getWorkspaceByID(workspace)->m_iMonitorID);
 	}
 
 	if (monitor == nullptr) {
-		Debug::log(ERR, "Orphaned Node %x (workspace ID: %i)!!", node, node->workspace_id);
+		Debug::log(ERR, "Orphaned Node %x (workspace ID: %i)!!", node, workspace);
 		errorNotif();
 		return;
 	}
 
-	// for gaps outer
-	const bool display_left   = STICKS(node->position.x, monitor->vecPosition.x + monitor->vecReservedTopLeft.x);
-	const bool display_right  = STICKS(node->position.x + node->size.x, monitor->vecPosition.x + monitor->vecSize.x - monitor->vecReservedBottomRight.x);
-	const bool display_top    = STICKS(node->position.y, monitor->vecPosition.y + monitor->vecReservedTopLeft.y);
-	const bool display_bottom = STICKS(node->position.y + node->size.y, monitor->vecPosition.y + monitor->vecSize.y - monitor->vecReservedBottomRight.y);
+	// only possible for a window closed during this pass, the node is purged when the next one begins
+	if (!node->valid) return;
 
-	static const auto* border_size           = &HyprlandAPI::getConfigValue(PHANDLE, "general:border_size")->intValue;
-	static const auto* gaps_in               = &HyprlandAPI::getConfigValue(PHANDLE, "general:gaps_in")->intValue;
-	static const auto* gaps_out              = &HyprlandAPI::getConfigValue(PHANDLE, "general:gaps_out")->intValue;
-	static const auto* single_window_no_gaps = &HyprlandAPI::getConfigValue(PHANDLE, "plugin:hy3:no_gaps_when_only")->intValue;
+	// the index and snapshot only change with the tile, not with every relayout
+	if (node->position != node->indexed_position || node->size != node->indexed_size) {
+		node->indexed_position = node->position;
+		node->indexed_size = node->size;
+		this->markWorkspaceDirty(workspace);
+	}
 
-	if (!g_pCompositor->windowExists(window) || !window->m_bIsMapped) {
-		Debug::log(ERR, "Node %p holding invalid window %p!!", node, window);
-		errorNotif();
-		this->onWindowRemovedTiling(window);
+	// windows on hidden workspaces are not configured until the workspace is shown,
+	// tiles covered by a fullscreen window not until fullscreen ends.
+	// window nodes without a parent are the fullscreen window's own fake node.
+	if (!g_pCompositor->isWorkspaceVisible(workspace) || (node->parent != nullptr && isFullscreenOccluded(workspace))) {
+		node->geometry_pending = true;
+		this->hibernated_workspaces.insert(workspace);
 		return;
 	}
 
+	node->geometry_pending = false;
+
 	window->m_vSize = node->size;
 	window->m_vPosition = node->position;
 
-	auto calcPos = window->m_vPosition + Vector2D(*border_size, *border_size);
-	auto calcSize = window->m_vSize - Vector2D(2 * *border_size, 2 * *border_size);
-
-	auto root_node = this->getWorkspaceRootGroup(window->m_iWorkspaceID);
-	auto only_node = root_node->data.as_group.children.size() == 1
-		&& root_node->data.as_group.children.front()->data.type == Hy3NodeData::Window;
-
-	if (!g_pCompositor->isWorkspaceSpecial(window->m_iWorkspaceID)
-			&& ((*single_window_no_gaps && only_node)
-					 || (window->m_bIsFullscreen
-							 && g_pCompositor->getWorkspaceByID(window->m_iWorkspaceID)->m_efFullscreenMode == FULLSCREEN_FULL))
-	) {
-		window->m_vRealPosition = window->m_vPosition;
-		window->m_vRealSize = window->m_vSize;
+	Vector2D calcPos;
+	Vector2D calcSize;
 
+	if (!this->getTileBox(node, monitor, calcPos, calcSize)) {
+		this->stageWindowGeometry(window, calcPos, calcSize, false);
 		window->updateWindowDecos();
 
 		window->m_sSpecialRenderData.rounding = false;
@@ -526,43 +545,94 @@ void Hy3Layout::applyNodeDataToWindow(Hy3Node* node, bool force) {
 		window->m_sSpecialRenderData.border = true;
 		window->m_sSpecialRenderData.decorate = true;
 
-		Vector2D offset_topleft(
-			display_left ? *gaps_out : *gaps_in,
-			display_top ? *gaps_out : *gaps_in
-		);
+		// shown once resized clients have drawn at their new size, see applyTransaction
+		this->stageWindowGeometry(window, calcPos, calcSize, force);
+		window->updateWindowDecos();
+	}
+}
+
+bool Hy3Layout::getTileBox(Hy3Node* node, CMonitor* monitor, Vector2D& position, Vector2D& size) {
+	static const auto* border_size           = &HyprlandAPI::getConfigValue(PHANDLE, "general:border_size")->intValue;
+	static const auto* gaps_in               = &HyprlandAPI::getConfigValue(PHANDLE, "general:gaps_in")->intValue;
+	static const auto* gaps_out              = &HyprlandAPI::getConfigValue(PHANDLE, "general:gaps_out")->intValue;
+	static const auto* single_window_no_gaps = &HyprlandAPI::getConfigValue(PHANDLE, "plugin:hy3:no_gaps_when_only")->intValue;
 
-		Vector2D offset_bottomright(
-			display_right ? *gaps_out : *gaps_in,
-			display_bottom ? *gaps_out : *gaps_in
-		);
+	auto* window = toWindow(node->data.as_window);
+	auto workspace = node->getWorkspace();
+
+	position = node->position;
+	size = node->size;
+
+	auto* root_node = this->getWorkspaceRootGroup(workspace);
+	// placeholders next to the window take no space
+	auto only_node = root_node != nullptr
+		&& visibleChildCount(root_node->data.as_group) == 1
+		&& edgeChild(root_node->data.as_group, false)->data.type == Hy3NodeData::Window;
+
+	if (!g_pCompositor->isWorkspaceSpecial(workspace)
+			&& ((*single_window_no_gaps && only_node)
+					 || (window->m_bIsFullscreen
+							 && g_pCompositor->getWorkspaceByID(workspace)->m_efFullscreenMode == FULLSCREEN_FULL))
+	) {
+		return false;
+	}
 
-		calcPos = calcPos + offset_topleft;
-		calcSize = calcSize - offset_topleft - offset_bottomright;
+	// for gaps outer
+	const bool display_left   = STICKS(node->position.x, monitor->vecPosition.x + monitor->vecReservedTopLeft.x);
+	const bool display_right  = STICKS(node->position.x + node->size.x, monitor->vecPosition.x + monitor->vecSize.x - monitor->vecReservedBottomRight.x);
+	const bool display_top    = STICKS(node->position.y, monitor->vecPosition.y + monitor->vecReservedTopLeft.y);
+	const bool display_bottom = STICKS(node->position.y + node->size.y, monitor->vecPosition.y + monitor->vecSize.y - monitor->vecReservedBottomRight.y);
 
-		const auto reserved_area = window->getFullWindowReservedArea();
-		calcPos = calcPos + reserved_area.topLeft;
-		calcSize = calcSize - (reserved_area.topLeft - reserved_area.bottomRight);
+	Vector2D offset_topleft(
+		display_left ? *gaps_out : *gaps_in,
+		display_top ? *gaps_out : *gaps_in
+	);
 
-		window->m_vRealPosition = calcPos;
-		window->m_vRealSize = calcSize;
-		Debug::log(LOG, "Set size (%f %f)", calcSize.x, calcSize.y);
+	Vector2D offset_bottomright(
+		display_right ? *gaps_out : *gaps_in,
+		display_bottom ? *gaps_out : *gaps_in
+	);
 
-		g_pXWaylandManager->setWindowSize(window, calcSize);
+	position = position + Vector2D(*border_size, *border_size) + offset_topleft;
+	size = size - Vector2D(2 * *border_size, 2 * *border_size) - offset_topleft - offset_bottomright;
 
-		if (force) {
-			g_pHyprRenderer->damageWindow(window);
+	const auto reserved_area = window->getFullWindowReservedArea();
+	position = position + reserved_area.topLeft;
+	size = size - (reserved_area.topLeft - reserved_area.bottomRight);
 
-			window->m_vRealPosition.warp();
-			window->m_vRealSize.warp();
+	return true;
+}
 
-			g_pHyprRenderer->damageWindow(window);
+void Hy3Layout::applyPendingGeometry(Hy3Node* node) {
+	switch (node->data.type) {
+	case Hy3NodeData::Window:
+		if (node->geometry_pending) this->applyNodeDataToWindow(node, true);
+		break;
+	case Hy3NodeData::Group:
+		for (auto* child: node->data.as_group.children) {
+			this->applyPendingGeometry(child);
 		}
-
-		window->updateWindowDecos();
+		break;
 	}
 }
 
+void Hy3Layout::wakeWorkspace(int workspace) {
+	// stays hibernated until fullscreen ends
+	if (isFullscreenOccluded(workspace)) return;
+	if (!this->hibernated_workspaces.erase(workspace)) return;
+
+	auto* root = this->getWorkspaceRootGroup(workspace);
+	if (root == nullptr) return;
+
+	Debug::log(LOG, "Applying deferred geometry of workspace %d", workspace);
+	Hy3TreePass pass(this);
+
+	// warped, so windows don't animate in from where they were when the workspace was hidden
+	this->applyPendingGeometry(root);
+}
+
 void Hy3Layout::onWindowCreatedTiling(CWindow* window) {
+	stats::Timer timer(stats::Timing::OnWindowCreatedTiling);
 	if (window->m_bIsFloating) return;
 
 	auto* existing = this->getNodeFromWindow(window);
@@ -571,9 +641,11 @@ void Hy3Layout::onWindowCreatedTiling(CWindow* window) {
 		return;
 	}
 
+	if (this->retilePlaceholder(window)) return;
+	if (this->placeFromTemplate(window)) return;
+
 	auto* monitor = g_pCompositor->getMonitorFromID(window->m_iMonitorID);
 
-	Hy3Node* opening_into;
 	Hy3Node* opening_after;
 
 	if (g_pCompositor->m_pLastWindow != nullptr
@@ -584,71 +656,28 @@ void Hy3Layout::onWindowCreatedTiling(CWindow* window) {
 	{
 		opening_after = this->getNodeFromWindow(g_pCompositor->m_pLastWindow);
 	} else {
-		opening_after = this->getNodeFromWindow(g_pCompositor->vectorToWindowTiled(g_pInputManager->getMouseCoordsInternal()));
+		opening_after = this->getNodeAtFromIndex(window->m_iWorkspaceID, g_pInputManager->getMouseCoordsInternal());
 	}
 
-	if (opening_after != nullptr && opening_after->workspace_id != window->m_iWorkspaceID) {
+	if (opening_after != nullptr && opening_after->getWorkspace() != window->m_iWorkspaceID) {
 		opening_after = nullptr;
 	}
 
-	if (opening_after != nullptr) {
-		opening_into = opening_after->parent;
-	} else {
-		if ((opening_into = this->getWorkspaceRootGroup(window->m_iWorkspaceID)) == nullptr) {
-			this->nodes.push_back({
-				.data = Hy3GroupLayout::SplitH,
-				.position = monitor->vecPosition + monitor->vecReservedTopLeft,
-				.size = monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight,
-				.workspace_id = window->m_iWorkspaceID,
-				.layout = this,
-			});
-
-			opening_into = &this->nodes.back();
-		}
-	}
-
-	if (opening_into->data.type != Hy3NodeData::Group) {
-		Debug::log(ERR, "opening_into node %p was not of type Group", opening_into);
-		errorNotif();
-		return;
-	}
-
-	if (opening_into->workspace_id != window->m_iWorkspaceID) {
-		Debug::log(WARN, "opening_into node %p has workspace %d which does not match the opening window (workspace %d)", opening_into, opening_into->workspace_id, window->m_iWorkspaceID);
-	}
-
-	this->nodes.push_back({
-		.parent = opening_into,
-		.data = window,
-		.workspace_id = window->m_iWorkspaceID,
-		.layout = this,
-	});
-
-	auto& node = this->nodes.back();
+	auto* node = this->insertWindow(
+		toHandle(window),
+		window->m_iWorkspaceID,
+		opening_after,
+		monitor->vecPosition + monitor->vecReservedTopLeft,
+		monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight
+	);
 
-	if (opening_after == nullptr) {
-		opening_into->data.as_group.children.push_back(&node);
-	} else {
-		auto& children = opening_into->data.as_group.children;
-		auto iter = std::find(children.begin(), children.end(), opening_after);
-		auto iter2 = std::next(iter);
-		children.insert(iter2, &node);
+	if (node != nullptr) {
+		Debug::log(LOG, "opening_into (%p) contains new child (%p)? %d", node->parent, node, node->parent->data.as_group.hasChild(node));
 	}
-	Debug::log(LOG, "opened new window %p(node: %p) on window %p in %p", window, &node, opening_after, opening_into);
-
-	node.markFocused();
-	opening_into->recalcSizePosRecursive();
-	Debug::log(LOG, "opening_into (%p) contains new child (%p)? %d", opening_into, &node, opening_into->data.as_group.hasChild(&node));
 }
 
 void Hy3Layout::onWindowRemovedTiling(CWindow* window) {
-	auto* node = this->getNodeFromWindow(window);
-	Debug::log(LOG, "remove tiling %p (window %p)", node, window);
-
-	if (node == nullptr) {
-		Debug::log(ERR, "onWindowRemovedTiling node null?");
-		return;
-	}
+	stats::Timer timer(stats::Timing::OnWindowRemovedTiling);
 
 	window->m_sSpecialRenderData.rounding = true;
 	window->m_sSpecialRenderData.border = true;
@@ -658,40 +687,115 @@ void Hy3Layout::onWindowRemovedTiling(CWindow* window) {
 		g_pCompositor->setWindowFullscreen(window, false, FULLSCREEN_FULL);
 	}
 
-	auto* parent = node->removeFromParentRecursive();
-	this->nodes.remove(*node);
+	// the node of a closed window is already removed once the pass begins
+	Hy3TreePass pass(this);
 
-	if (parent != nullptr) {
-		parent->recalcSizePosRecursive();
-
-		if (parent->data.as_group.children.size() == 1
-				&& parent->data.as_group.children.front()->data.type == Hy3NodeData::Group)
-		{
-			auto* target_parent = parent;
-			while (target_parent != nullptr && Hy3Node::swallowGroups(target_parent)) {
-				target_parent = target_parent->parent;
+	auto* node = this->getNodeFromWindow(window);
+	Debug::log(LOG, "remove tiling %p (window %p)", node, window);
+	if (node == nullptr) return;
+
+	// a window made floating leaves its node behind to return to when it is tiled again
+	if (window->m_bIsFloating) {
+		Debug::log(LOG, "Window %p floated, keeping %p as its placeholder", window, node);
+		if (this->drag_move.window == window) this->drag_move.window = nullptr;
+		this->dropTransactionWindow(window);
+		this->selected_windows.erase(window);
+
+		this->markWorkspaceDirty(node->getWorkspace());
+
+		// the highest node that no longer takes any space, its parent gets relaid out
+		auto* collapsed = node;
+		node->placeholder = true;
+		node->mruUnlink();
+		while (collapsed->parent != nullptr && collapsed->parent->isCollapsed()) collapsed = collapsed->parent;
+
+		// focus moves to the most recently focused node still taking space
+		for (auto* child = node; child->parent != nullptr; child = child->parent) {
+			auto& group = child->parent->data.as_group;
+			if (group.focused_child != child) break;
+
+			auto* next = mruVisibleChild(group);
+
+			for (auto iter = group.children.begin(); iter != group.children.end() && next == nullptr; ++iter) {
+				if (!(*iter)->isCollapsed()) next = *iter;
 			}
 
-			if (target_parent != parent && target_parent != nullptr)
-				target_parent->recalcSizePosRecursive();
+			if (next != nullptr) {
+				group.focused_child = next;
+				group.group_focused = false;
+				this->tree_changed = true;
+				tree_events::focusChanged(next->getFocusedNode());
+				break;
+			}
 		}
+
+		(collapsed->parent != nullptr ? collapsed->parent : collapsed)->recalcSizePosRecursive();
+		return;
 	}
 
+	this->removeWindowNode(node);
+}
+
+void Hy3Layout::onWindowRemovedFloating(CWindow* window) {
+	IHyprLayout::onWindowRemovedFloating(window);
+
+	// closed or moved to another workspace while floating
+	auto* node = this->getPlaceholderFromWindow(window);
+	if (node == nullptr) return;
+
+	Hy3TreePass pass(this);
+	this->removeWindowNode(node);
+}
+
+bool Hy3Layout::retilePlaceholder(CWindow* window) {
+	auto* node = this->getPlaceholderFromWindow(window);
+	if (node == nullptr) return false;
+
+	Hy3TreePass pass(this);
+
+	if (node->getWorkspace() != window->m_iWorkspaceID) {
+		this->removeWindowNode(node);
+		return false;
+	}
+
+	// relayout the parent of the highest node that took no space without the window
+	auto* relayout = node;
+	while (relayout->parent != nullptr && relayout->parent->isCollapsed()) relayout = relayout->parent;
+	if (relayout->parent != nullptr) relayout = relayout->parent;
+
+	Debug::log(LOG, "Retiling window %p into its placeholder %p", window, node);
+	node->placeholder = false;
+	this->markWorkspaceDirty(node->getWorkspace());
+	node->markFocused();
+	relayout->recalcSizePosRecursive();
+
+	return true;
+}
+
+void Hy3Layout::removeWindowNode(Hy3Node* node) {
+	auto* window = toWindow(node->data.as_window);
+	if (this->drag_move.window == window) this->drag_move.window = nullptr;
+	this->dropTransactionWindow(window);
+	this->selected_windows.erase(window);
+
+	this->deleteNode(node);
 }
 
 CWindow* Hy3Layout::getNextWindowCandidate(CWindow* window) {
+	stats::Timer timer(stats::Timing::GetNextWindowCandidate);
 	auto* node = this->getWorkspaceFocusedNode(window->m_iWorkspaceID);
 	if (node == nullptr) return nullptr;
 
 	switch (node->data.type) {
 	case Hy3NodeData::Window:
-		return node->data.as_window;
+		return toWindow(node->data.as_window);
 	case Hy3NodeData::Group:
 		return nullptr;
 	}
 }
 
 void Hy3Layout::onWindowFocusChange(CWindow* window) {
+	stats::Timer timer(stats::Timing::OnWindowFocusChange);
 	Debug::log(LOG, "Switched windows to %p", window);
 	auto* node = this->getNodeFromWindow(window);
 	if (node == nullptr) return;
@@ -704,16 +808,22 @@ bool Hy3Layout::isWindowTiled(CWindow* window) {
 }
 
 void Hy3Layout::recalculateMonitor(const int& monitor_id) {
+	stats::Timer timer(stats::Timing::RecalculateMonitor);
 	Debug::log(LOG, "Recalculate monitor %d", monitor_id);
 	const auto monitor = g_pCompositor->getMonitorFromID(monitor_id);
 	if (monitor == nullptr) return;
 
-	g_pHyprRenderer->damageMonitor(monitor);
+	// windows that move during this pass damage their old and new areas
+	Hy3TreePass pass(this);
 
 	const auto workspace = g_pCompositor->getWorkspaceByID(monitor->activeWorkspace);
 	if (workspace == nullptr) return;
 
+	this->wakeWorkspace(monitor->activeWorkspace);
+
 	if (monitor->specialWorkspaceID) {
+		this->wakeWorkspace(monitor->specialWorkspaceID);
+
 		const auto top_node = this->getWorkspaceRootGroup(monitor->specialWorkspaceID);
 
 		if (top_node != nullptr) {
@@ -727,13 +837,12 @@ void Hy3Layout::recalculateMonitor(const int& monitor_id) {
 		const auto window = g_pCompositor->getFullscreenWindowOnWorkspace(workspace->m_iID);
 
 		if (workspace->m_efFullscreenMode == FULLSCREEN_FULL) {
-			window->m_vRealPosition = monitor->vecPosition;
-			window->m_vRealSize = monitor->vecSize;
+			this->stageWindowGeometry(window, monitor->vecPosition, monitor->vecSize, false);
 		} else {
 			// Vaxry's hack from below, but again
 
 			Hy3Node fakeNode = {
-				.data = window,
+				.data = toHandle(window),
 				.position = monitor->vecPosition + monitor->vecReservedTopLeft,
 				.size = monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight,
 				.workspace_id = window->m_iWorkspaceID,
@@ -753,6 +862,7 @@ void Hy3Layout::recalculateMonitor(const int& monitor_id) {
 }
 
 void Hy3Layout::recalculateWindow(CWindow* window) {
+	stats::Timer timer(stats::Timing::RecalculateWindow);
 	auto* node = this->getNodeFromWindow(window);
 	if (node == nullptr) return;
 	node->recalcSizePosRecursive();
@@ -760,10 +870,161 @@ void Hy3Layout::recalculateWindow(CWindow* window) {
 
 void Hy3Layout::onBeginDragWindow() {
 	this->drag_flags.started = false;
+
+	auto* window = g_pInputManager->currentlyDraggedWindow;
+	if (g_pInputManager->dragMode == MBIND_MOVE
+			&& window != nullptr
+			&& !window->m_bIsFloating
+			&& !window->m_bIsFullscreen
+			&& this->getNodeFromWindow(window) != nullptr)
+	{
+		// tiled windows are moved within the tree instead of floating them while dragging
+		this->drag_move.window = window;
+		this->drag_move.target = {};
+		return;
+	}
+
 	IHyprLayout::onBeginDragWindow();
 }
 
+void Hy3Layout::onMouseMove(const Vector2D& mouse) {
+	if (this->drag_move.window == nullptr) {
+		IHyprLayout::onMouseMove(mouse);
+		return;
+	}
+
+	trace::Span span("dragMove");
+	auto* window = this->drag_move.window;
+
+	Hy3DropTarget target;
+	if (!this->getDropTarget(window, mouse, target) || target == this->drag_move.target) return;
+
+	// only the dragged window is moved to preview the drop, nothing is reconfigured
+	this->drag_move.target = target;
+	window->m_vRealPosition = target.preview_position;
+	window->m_vRealSize = target.preview_size;
+}
+
+void Hy3Layout::onEndDragWindow() {
+	auto* window = this->drag_move.window;
+
+	if (window != nullptr) {
+		this->drag_move.window = nullptr;
+
+		if (g_pCompositor->windowValidMapped(window)) {
+			Hy3DropTarget target;
+			auto mouse = g_pInputManager->getMouseCoordsInternal();
+
+			if (!this->getDropTarget(window, mouse, target) || !this->dropWindow(window, target)) {
+				// dropped in place, undo the preview
+				auto* node = this->getNodeFromWindow(window);
+				if (node != nullptr) node->recalcSizePosRecursive();
+			}
+		}
+	}
+
+	IHyprLayout::onEndDragWindow();
+}
+
+bool Hy3Layout::getDropTarget(CWindow* dragged, const Vector2D& mouse, Hy3DropTarget& target) {
+	auto* monitor = g_pCompositor->getMonitorFromVector(mouse);
+	if (monitor == nullptr) return false;
+
+	target.workspace = monitor->specialWorkspaceID != 0 ? monitor->specialWorkspaceID : monitor->activeWorkspace;
+	auto* workspace = g_pCompositor->getWorkspaceByID(target.workspace);
+	if (workspace == nullptr || workspace->m_bHasFullscreenWindow) return false;
+
+	auto* node = this->getNodeAtFromIndex(target.workspace, mouse);
+
+	if (node == nullptr) {
+		// open space is only a target on workspaces without tiled windows
+		if (this->getWorkspaceRootGroup(target.workspace) != nullptr) return false;
+
+		target.preview_position = monitor->vecPosition + monitor->vecReservedTopLeft;
+		target.preview_size = monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight;
+		return true;
+	}
+
+	target.window = toWindow(node->data.as_window);
+	// the preview covers what the window is actually drawn over, not the raw tile
+	this->getTileBox(node, monitor, target.preview_position, target.preview_size);
+
+	// hovering the dragged window's own tile drops it back in place
+	if (target.window == dragged) return true;
+
+	// the closest edge within a quarter of the window, otherwise the center tabs into it
+	auto u = (mouse.x - node->position.x) / node->size.x;
+	auto v = (mouse.y - node->position.y) / node->size.y;
+	double distances[4] = {u, v, 1.0 - v, 1.0 - u};
+
+	auto closest = std::min_element(distances, distances + 4) - distances;
+	target.edge = (ShiftDirection) closest;
+	target.tab = distances[closest] > 0.25;
+
+	if (!target.tab) {
+		switch (target.edge) {
+		case ShiftDirection::Left:
+			target.preview_size.x /= 2;
+			break;
+		case ShiftDirection::Right:
+			target.preview_size.x /= 2;
+			target.preview_position.x += target.preview_size.x;
+			break;
+		case ShiftDirection::Up:
+			target.preview_size.y /= 2;
+			break;
+		case ShiftDirection::Down:
+			target.preview_size.y /= 2;
+			target.preview_position.y += target.preview_size.y;
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool Hy3Layout::dropWindow(CWindow* window, const Hy3DropTarget& target) {
+	auto* node = this->getNodeFromWindow(window);
+	if (node == nullptr || target.window == window) return false;
+
+	Hy3Node* neighbor = nullptr;
+	auto before = false;
+
+	if (target.window != nullptr) {
+		neighbor = this->getNodeFromWindow(target.window);
+		if (neighbor == nullptr) return false;
+	}
+
+	auto origin = node->getWorkspace();
+	Hy3HistoryEdit origin_edit(this, origin);
+	std::optional<Hy3HistoryEdit> target_edit;
+	if (target.workspace != origin) target_edit.emplace(this, target.workspace);
+
+	if (neighbor != nullptr) {
+		auto& group = neighbor->parent->data.as_group;
+
+		if (target.tab) {
+			if (group.layout != Hy3GroupLayout::Tabbed) neighbor = neighbor->intoGroup(Hy3GroupLayout::Tabbed);
+		} else {
+			before = !shiftIsForward(target.edge);
+
+			// dropping on an edge across the parent's direction, or in a tab group, splits the target
+			if (group.layout == Hy3GroupLayout::Tabbed || !shiftMatchesLayout(group.layout, target.edge)) {
+				neighbor = neighbor->intoGroup(shiftIsVertical(target.edge) ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH);
+			}
+		}
+	}
+
+	Debug::log(LOG, "Dropping window %p next to %p (before: %d, tab: %d)", window, neighbor, before, target.tab);
+	this->moveNodeToWorkspace(node, target.workspace, neighbor, before);
+	node->focus();
+
+	return true;
+}
+
 void Hy3Layout::resizeActiveWindow(const Vector2D& delta, CWindow* pWindow) {
+	stats::Timer timer(stats::Timing::ResizeActiveWindow);
+	trace::Span span("resizeActiveWindow");
 	auto window = pWindow ? pWindow : g_pCompositor->m_pLastWindow;
 	if (!g_pCompositor->windowValidMapped(window)) return;
 
@@ -812,17 +1073,18 @@ void Hy3Layout::resizeActiveWindow(const Vector2D& delta, CWindow* pWindow) {
 
 		switch (group.layout) {
 		case Hy3GroupLayout::Tabbed:
+		case Hy3GroupLayout::Accordion:
 			// treat tabbed layouts as if they dont exist during resizing
 			goto cont;
 		case Hy3GroupLayout::SplitH:
-			if ((this->drag_flags.xExtent && group.children.back() == inner_node)
-					|| (!this->drag_flags.xExtent && group.children.front() == inner_node)) {
+			if ((this->drag_flags.xExtent && edgeChild(group, true) == inner_node)
+					|| (!this->drag_flags.xExtent && edgeChild(group, false) == inner_node)) {
 				goto cont;
 			}
 			break;
 		case Hy3GroupLayout::SplitV:
-			if ((this->drag_flags.yExtent && group.children.back() == inner_node)
-					|| (!this->drag_flags.yExtent && group.children.front() == inner_node)) {
+			if ((this->drag_flags.yExtent && edgeChild(group, true) == inner_node)
+					|| (!this->drag_flags.yExtent && edgeChild(group, false) == inner_node)) {
 				goto cont;
 			}
 			break;
@@ -848,17 +1110,18 @@ void Hy3Layout::resizeActiveWindow(const Vector2D& delta, CWindow* pWindow) {
 
 		switch (group.layout) {
 		case Hy3GroupLayout::Tabbed:
+		case Hy3GroupLayout::Accordion:
 			// treat tabbed layouts as if they dont exist during resizing
 			goto cont2;
 		case Hy3GroupLayout::SplitH:
-			if ((this->drag_flags.xExtent && group.children.back() == outer_node)
-					|| (!this->drag_flags.xExtent && group.children.front() == outer_node)) {
+			if ((this->drag_flags.xExtent && edgeChild(group, true) == outer_node)
+					|| (!this->drag_flags.xExtent && edgeChild(group, false) == outer_node)) {
 				goto cont2;
 			}
 			break;
 		case Hy3GroupLayout::SplitV:
-			if ((this->drag_flags.yExtent && group.children.back() == outer_node)
-					|| (!this->drag_flags.yExtent && group.children.front() == outer_node)) {
+			if ((this->drag_flags.yExtent && edgeChild(group, true) == outer_node)
+					|| (!this->drag_flags.yExtent && edgeChild(group, false) == outer_node)) {
 				goto cont2;
 			}
 			break;
@@ -875,42 +1138,30 @@ void Hy3Layout::resizeActiveWindow(const Vector2D& delta, CWindow* pWindow) {
 	// adjust the inner node
 	switch (inner_group.layout) {
 	case Hy3GroupLayout::SplitH: {
-		auto ratio_mod = allowed_movement.x * (float) inner_group.children.size() / inner_parent->size.x;
-
-		auto iter = std::find(inner_group.children.begin(), inner_group.children.end(), inner_node);
+		auto ratio_mod = allowed_movement.x * (float) visibleChildCount(inner_group) / inner_parent->size.x;
 
-		if (this->drag_flags.xExtent) {
-			if (inner_node == inner_group.children.back()) break;
-			iter = std::next(iter);
-		} else {
-			if (inner_node == inner_group.children.front()) break;
-			iter = std::prev(iter);
-			ratio_mod = -ratio_mod;
-		}
-
-		auto* neighbor = *iter;
+		// placeholders take no space, the ratio is traded with the closest visible sibling
+		auto* neighbor = visibleSibling(inner_node, this->drag_flags.xExtent);
+		if (neighbor == nullptr) break;
+		if (!this->drag_flags.xExtent) ratio_mod = -ratio_mod;
 
 		inner_node->size_ratio += ratio_mod;
 		neighbor->size_ratio -= ratio_mod;
+		tree_events::ratioChanged(inner_node);
+		tree_events::ratioChanged(neighbor);
 	} break;
 	case Hy3GroupLayout::SplitV: {
-		auto ratio_mod = allowed_movement.y * (float) inner_parent->data.as_group.children.size() / inner_parent->size.y;
+		auto ratio_mod = allowed_movement.y * (float) visibleChildCount(inner_group) / inner_parent->size.y;
 
-		auto iter = std::find(inner_group.children.begin(), inner_group.children.end(), inner_node);
-
-		if (this->drag_flags.yExtent) {
-			if (inner_node == inner_group.children.back()) break;
-			iter = std::next(iter);
-		} else {
-			if (inner_node == inner_group.children.front()) break;
-			iter = std::prev(iter);
-			ratio_mod = -ratio_mod;
-		}
-
-		auto* neighbor = *iter;
+		// placeholders take no space, the ratio is traded with the closest visible sibling
+		auto* neighbor = visibleSibling(inner_node, this->drag_flags.yExtent);
+		if (neighbor == nullptr) break;
+		if (!this->drag_flags.yExtent) ratio_mod = -ratio_mod;
 
 		inner_node->size_ratio += ratio_mod;
 		neighbor->size_ratio -= ratio_mod;
+		tree_events::ratioChanged(inner_node);
+		tree_events::ratioChanged(neighbor);
 	} break;
 	}
 
@@ -922,42 +1173,30 @@ void Hy3Layout::resizeActiveWindow(const Vector2D& delta, CWindow* pWindow) {
 		// adjust the outer node
 		switch (outer_group.layout) {
 		case Hy3GroupLayout::SplitH: {
-			auto ratio_mod = allowed_movement.x * (float) outer_group.children.size() / outer_parent->size.x;
-
-			auto iter = std::find(outer_group.children.begin(), outer_group.children.end(), outer_node);
-
-			if (this->drag_flags.xExtent) {
-				if (outer_node == inner_group.children.back()) break;
-				iter = std::next(iter);
-			} else {
-				if (outer_node == inner_group.children.front()) break;
-				iter = std::prev(iter);
-				ratio_mod = -ratio_mod;
-			}
+			auto ratio_mod = allowed_movement.x * (float) visibleChildCount(outer_group) / outer_parent->size.x;
 
-			auto* neighbor = *iter;
+			// placeholders take no space, the ratio is traded with the closest visible sibling
+			auto* neighbor = visibleSibling(outer_node, this->drag_flags.xExtent);
+			if (neighbor == nullptr) break;
+			if (!this->drag_flags.xExtent) ratio_mod = -ratio_mod;
 
 			outer_node->size_ratio += ratio_mod;
 			neighbor->size_ratio -= ratio_mod;
+			tree_events::ratioChanged(outer_node);
+			tree_events::ratioChanged(neighbor);
 		} break;
 		case Hy3GroupLayout::SplitV: {
-			auto ratio_mod = allowed_movement.y * (float) outer_parent->data.as_group.children.size() / outer_parent->size.y;
+			auto ratio_mod = allowed_movement.y * (float) visibleChildCount(outer_group) / outer_parent->size.y;
 
-			auto iter = std::find(outer_group.children.begin(), outer_group.children.end(), outer_node);
-
-			if (this->drag_flags.yExtent) {
-				if (outer_node == outer_group.children.back()) break;
-				iter = std::next(iter);
-			} else {
-				if (outer_node == outer_group.children.front()) break;
-				iter = std::prev(iter);
-				ratio_mod = -ratio_mod;
-			}
-
-			auto* neighbor = *iter;
+			// placeholders take no space, the ratio is traded with the closest visible sibling
+			auto* neighbor = visibleSibling(outer_node, this->drag_flags.yExtent);
+			if (neighbor == nullptr) break;
+			if (!this->drag_flags.yExtent) ratio_mod = -ratio_mod;
 
 			outer_node->size_ratio += ratio_mod;
 			neighbor->size_ratio -= ratio_mod;
+			tree_events::ratioChanged(outer_node);
+			tree_events::ratioChanged(neighbor);
 		} break;
 		}
 
@@ -966,6 +1205,7 @@ void Hy3Layout::resizeActiveWindow(const Vector2D& delta, CWindow* pWindow) {
 }
 
 void Hy3Layout::fullscreenRequestForWindow(CWindow* window, eFullscreenMode fullscreen_mode, bool on) {
+	stats::Timer timer(stats::Timing::FullscreenRequestForWindow);
 	if (!g_pCompositor->windowValidMapped(window)) return;
 	if (on == window->m_bIsFullscreen || g_pCompositor->isWorkspaceSpecial(window->m_iWorkspaceID)) return;
 
@@ -973,6 +1213,9 @@ void Hy3Layout::fullscreenRequestForWindow(CWindow* window, eFullscreenMode full
 	const auto workspace = g_pCompositor->getWorkspaceByID(window->m_iWorkspaceID);
 	if (workspace->m_bHasFullscreenWindow && on) return;
 
+	// leaving fullscreen applies the deferred geometry of the tiles below in the same transaction
+	Hy3TreePass pass(this);
+
 	window->m_bIsFullscreen = on;
 	workspace->m_bHasFullscreenWindow = !workspace->m_bHasFullscreenWindow;
 
@@ -982,10 +1225,9 @@ void Hy3Layout::fullscreenRequestForWindow(CWindow* window, eFullscreenMode full
 		if (node) {
 			// restore node positioning if tiled
 			this->applyNodeDataToWindow(node);
-		} else {
-			// restore floating position if not
-			window->m_vRealPosition = window->m_vLastFloatingPosition;
-			window->m_vRealSize = window->m_vLastFloatingSize;
+		} else if (window->m_bIsFloating) {
+			// restore floating position if not. a closing tiled window has no node left either.
+			this->stageWindowGeometry(window, window->m_vLastFloatingPosition, window->m_vLastFloatingSize, false);
 
 			window->m_sSpecialRenderData.rounding = true;
 			window->m_sSpecialRenderData.border = true;
@@ -1004,14 +1246,13 @@ void Hy3Layout::fullscreenRequestForWindow(CWindow* window, eFullscreenMode full
 
 		if (fullscreen_mode == FULLSCREEN_FULL) {
 			Debug::log(LOG, "fullscreen");
-			window->m_vRealPosition = monitor->vecPosition;
-			window->m_vRealSize = monitor->vecSize;
+			this->stageWindowGeometry(window, monitor->vecPosition, monitor->vecSize, false);
 		} else {
 			Debug::log(LOG, "vaxry hack");
 			// Copy of vaxry's massive hack
 
 			Hy3Node fakeNode = {
-				.data = window,
+				.data = toHandle(window),
 				.position = monitor->vecPosition + monitor->vecReservedTopLeft,
 				.size = monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight,
 				.workspace_id = window->m_iWorkspaceID,
@@ -1021,13 +1262,14 @@ void Hy3Layout::fullscreenRequestForWindow(CWindow* window, eFullscreenMode full
 		}
 	}
 
+	// the client is configured with its final size when the pass flushes the transaction
 	g_pCompositor->updateWindowAnimatedDecorationValues(window);
-	g_pXWaylandManager->setWindowSize(window, window->m_vRealSize.goalv());
 	g_pCompositor->moveWindowToTop(window);
 	this->recalculateMonitor(monitor->ID);
 }
 
 std::any Hy3Layout::layoutMessage(SLayoutMessageHeader header, std::string content) {
+	stats::Timer timer(stats::Timing::LayoutMessage);
 	if (content == "togglesplit") {
 		auto* node = this->getNodeFromWindow(header.pWindow);
 		if (node != nullptr && node->parent != nullptr) {
@@ -1036,13 +1278,16 @@ std::any Hy3Layout::layoutMessage(SLayoutMessageHeader header, std::string conte
 			switch (layout) {
 			case Hy3GroupLayout::SplitH:
 			  layout = Hy3GroupLayout::SplitV;
+				tree_events::layoutChanged(node->parent);
 				node->parent->recalcSizePosRecursive();
 				break;
 			case Hy3GroupLayout::SplitV:
 				layout = Hy3GroupLayout::SplitH;
+				tree_events::layoutChanged(node->parent);
 				node->parent->recalcSizePosRecursive();
 				break;
 			case Hy3GroupLayout::Tabbed:
+			case Hy3GroupLayout::Accordion:
 				break;
 			}
 		}
@@ -1052,15 +1297,98 @@ std::any Hy3Layout::layoutMessage(SLayoutMessageHeader header, std::string conte
 }
 
 SWindowRenderLayoutHints Hy3Layout::requestRenderHints(CWindow* window) {
-	return {};
+	stats::Timer timer(stats::Timing::RequestRenderHints);
+	SWindowRenderLayoutHints hints;
+
+	static const auto* active_border = HyprlandAPI::getConfigValue(PHANDLE, "general:col.active_border");
+
+	if (this->selected_windows.contains(window)) {
+		// the gradient itself is replaced when the config is reloaded, only the value is cached
+		hints.isBorderGradient = true;
+		hints.borderGradient = (CGradientValueData*) active_border->data.get();
+	}
+
+	return hints;
+}
+
+// move a window to another workspace through hyprland, so the movewindow event,
+// moveWindow hook and render state of special workspaces follow it
+static void moveWindowToWorkspace(CWindow* window, int workspace) {
+	auto* target = g_pCompositor->getWorkspaceByID(workspace);
+	if (target == nullptr) return;
+
+	window->moveToWorkspace(workspace);
+	window->m_iMonitorID = target->m_iMonitorID;
+	g_pCompositor->updateWindowAnimatedDecorationValues(window);
 }
 
 void Hy3Layout::switchWindows(CWindow* pWindowA, CWindow* pWindowB) {
-	// todo
+	stats::Timer timer(stats::Timing::SwitchWindows);
+	if (pWindowA == pWindowB || pWindowA->m_bIsFullscreen || pWindowB->m_bIsFullscreen) return;
+
+	auto* a = this->getNodeFromWindow(pWindowA);
+	auto* b = this->getNodeFromWindow(pWindowB);
+	if (a == nullptr || b == nullptr) return;
+
+	Hy3TreePass pass(this);
+
+	// only the windows change places, the tree itself is untouched
+	std::swap(a->data.as_window, b->data.as_window);
+	std::swap(a->id, b->id);
+
+	auto workspace_a = pWindowA->m_iWorkspaceID;
+	auto workspace_b = pWindowB->m_iWorkspaceID;
+
+	if (workspace_a != workspace_b) {
+		moveWindowToWorkspace(pWindowA, workspace_b);
+		moveWindowToWorkspace(pWindowB, workspace_a);
+	}
+
+	tree_events::moved(a);
+	tree_events::moved(b);
+
+	if (g_pCompositor->m_pLastWindow == pWindowA) b->markFocused();
+	else if (g_pCompositor->m_pLastWindow == pWindowB) a->markFocused();
+
+	a->recalcSizePosRecursive();
+	b->recalcSizePosRecursive();
 }
 
 void Hy3Layout::alterSplitRatio(CWindow* pWindow, float delta, bool exact) {
-	// todo
+	stats::Timer timer(stats::Timing::AlterSplitRatio);
+	auto* node = this->getNodeFromWindow(pWindow);
+	if (node == nullptr) return;
+
+	// the closest split the node is part of, tabs and accordions have no ratios
+	while (node->parent != nullptr) {
+		auto& group = node->parent->data.as_group;
+		if ((group.layout == Hy3GroupLayout::SplitH || group.layout == Hy3GroupLayout::SplitV)
+				&& visibleChildCount(group) > 1)
+			break;
+
+		node = node->parent;
+	}
+
+	auto* parent = node->parent;
+	if (parent == nullptr) return;
+
+	// ratios are traded with the next visible node, or the previous one for the last node
+	auto* neighbor = visibleSibling(node, true);
+	if (neighbor == nullptr) neighbor = visibleSibling(node, false);
+
+	// like dwindle, 1.0 is an even split. neither node is shrunk below 0.1.
+	auto target = exact ? delta : node->size_ratio + delta;
+	auto change = hy3core::ratioTradeChange(node->size_ratio, neighbor->size_ratio, target);
+	if (change == 0.0) return;
+
+	Hy3TreePass pass(this);
+
+	node->size_ratio += change;
+	neighbor->size_ratio -= change;
+	tree_events::ratioChanged(node);
+	tree_events::ratioChanged(neighbor);
+
+	parent->recalcSizePosRecursive();
 }
 
 std::string Hy3Layout::getLayoutName() {
@@ -1068,379 +1396,1015 @@ std::string Hy3Layout::getLayoutName() {
 }
 
 void Hy3Layout::replaceWindowDataWith(CWindow* from, CWindow* to) {
+	stats::Timer timer(stats::Timing::ReplaceWindowDataWith);
 	auto* node = this->getNodeFromWindow(from);
 	if (node == nullptr) return;
 
-	node->data.as_window = to;
+	node->data.as_window = toHandle(to);
 	this->applyNodeDataToWindow(node);
 }
 
+static bool isTileable(CWindow* window) {
+	return !window->isHidden()
+		&& window->m_bIsMapped
+		&& !window->m_bFadingOut
+		&& !window->m_bIsFloating;
+}
+
 void Hy3Layout::onEnable() {
-	for (auto &window : g_pCompositor->m_vWindows) {
-		if (window->isHidden()
-				|| !window->m_bIsMapped
-				|| window->m_bFadingOut
-				|| window->m_bIsFloating)
-			continue;
+	stats::Timer timer(stats::Timing::OnEnable);
+	Hy3TreePass pass(this);
+
+	// The tree is kept while another layout is active. Windows closed since were purged
+	// when the pass began, drop the ones floated or moved to another workspace.
+	std::unordered_set<CWindow*> kept;
+	std::vector<Hy3Node*> stale;
+
+	for (auto& node: this->nodes) {
+		if (node.data.type != Hy3NodeData::Window) continue;
+		auto* window = toWindow(node.data.as_window);
+
+		if (node.placeholder) {
+			// kept as long as the window still floats on the same workspace
+			if (!window->m_bIsFloating || window->m_iWorkspaceID != node.getWorkspace()) {
+				stale.push_back(&node);
+			}
+		} else if (isTileable(window)
+				&& window->m_iWorkspaceID == node.getWorkspace())
+		{
+			kept.insert(window);
+		} else {
+			stale.push_back(&node);
+		}
+	}
 
+	for (auto* node: stale) {
+		node->removeFromParentRecursive();
+		tree_events::removed(node);
+		this->nodes.remove(*node);
+	}
+
+	for (auto& window: g_pCompositor->m_vWindows) {
+		if (!isTileable(window.get()) || kept.contains(window.get())) continue;
 		this->onWindowCreatedTiling(window.get());
 	}
 
-	selection_hook::enable();
+	Debug::log(LOG, "Reconciled dormant tree, %d windows kept, %d dropped", (int) kept.size(), (int) stale.size());
+
+	// the other layout moved every window, so everything is relaid out in this pass
+	for (auto& node: this->nodes) {
+		if (node.parent != nullptr || g_pCompositor->isWorkspaceVisible(node.workspace_id)) continue;
+
+		auto* workspace = g_pCompositor->getWorkspaceByID(node.workspace_id);
+		if (workspace == nullptr) continue;
+		auto* monitor = g_pCompositor->getMonitorFromID(workspace->m_iMonitorID);
+		if (monitor == nullptr) continue;
+
+		node.position = monitor->vecPosition + monitor->vecReservedTopLeft;
+		node.size = monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight;
+		node.recalcSizePosRecursive();
+	}
+
+	for (auto& monitor: g_pCompositor->m_vMonitors) {
+		this->recalculateMonitor(monitor->ID);
+	}
+
+	this->updateSelectedWindows();
 }
 
 void Hy3Layout::onDisable() {
-	selection_hook::disable();
-	this->nodes.clear();
+	stats::Timer timer(stats::Timing::OnDisable);
+
+	// the next layout draws its own borders. the set is emptied before the
+	// update so the windows are no longer drawn as selected.
+	auto selected = std::move(this->selected_windows);
+	this->selected_windows.clear();
+
+	for (auto* window: selected) {
+		if (window->m_bIsMapped) g_pCompositor->updateWindowAnimatedDecorationValues(window);
+	}
+
+	// the tree stays dormant until hy3 is enabled again, see onEnable
+	this->drag_move.window = nullptr;
+
+	// the next layout takes over from the geometry last computed by hy3
+	if (!this->transaction.empty()) this->applyTransaction();
 }
 
 void Hy3Layout::makeGroupOnWorkspace(int workspace, Hy3GroupLayout layout) {
+	Hy3HistoryEdit edit(this, workspace);
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	this->makeGroupOn(node, layout);
 }
 
 void Hy3Layout::makeOppositeGroupOnWorkspace(int workspace) {
+	Hy3HistoryEdit edit(this, workspace);
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	this->makeOppositeGroupOn(node);
 }
 
-void Hy3Layout::makeGroupOn(Hy3Node* node, Hy3GroupLayout layout) {
-	if (node == nullptr) return;
-
-	if (node->parent != nullptr) {
-		auto& group = node->parent->data.as_group;
-		if (group.children.size() == 1
-			&& (group.layout == Hy3GroupLayout::SplitH
-			|| group.layout == Hy3GroupLayout::SplitV))
-		{
-			group.layout = layout;
-			node->parent->recalcSizePosRecursive();
-			return;
-		}
+// true if moving focus from a window has to walk the tree. tabs and accordion
+// children are ordered by the tree rather than by geometry when moving along
+// their group, and a sibling of the window is found without a geometric search.
+// groups the move crosses are left to the index.
+static bool focusStaysInTree(Hy3Node* node, ShiftDirection direction) {
+	for (auto* origin = node; origin->parent != nullptr; origin = origin->parent) {
+		auto& group = origin->parent->data.as_group;
+		if (!shiftMatchesLayout(group.layout, direction)) continue;
+		if (group.layout == Hy3GroupLayout::Tabbed || group.layout == Hy3GroupLayout::Accordion) return true;
+
+		// the first group the focus can move within holds the target
+		if (edgeChild(group, shiftIsForward(direction)) != origin) return origin == node;
 	}
 
-	node->intoGroup(layout);
-}
-
-void Hy3Layout::makeOppositeGroupOn(Hy3Node* node) {
-	if (node == nullptr) return;
-
-	if (node->parent == nullptr) {
-		node->intoGroup(Hy3GroupLayout::SplitH);
-	} else {
-		auto& group = node->parent->data.as_group;
-		auto layout = group.layout == Hy3GroupLayout::SplitH
-			? Hy3GroupLayout::SplitV
-			: Hy3GroupLayout::SplitH;
-
-		if (group.children.size() == 1) {
-			group.layout = layout;
-			node->parent->recalcSizePosRecursive();
-		} else {
-			node->intoGroup(layout);
-		}
-	}
+	return false;
 }
 
 void Hy3Layout::shiftFocus(int workspace, ShiftDirection direction) {
+	Hy3TreePass pass(this);
+
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	Debug::log(LOG, "ShiftFocus %p %d", node, direction);
 	if (node == nullptr) return;
 
 	Hy3Node* target;
-	if ((target = this->shiftOrGetFocus(*node, direction, false, false))) {
-        target->focus();
-
-		std::cout << "Marking focus" << std::endl;
-
-		// If this node is in a group
-		if (target->parent != nullptr) {
-			double split_ratio = 0.05;
-			auto& children = target->parent->data.as_group.children;
-			std::cout << "Found " << children.size() << " children" << std::endl;
-			for (auto&& child : children) {
-				if (child != target) {
-					child->size_ratio = split_ratio;
-					child->recalcSizePosRecursive(true);
-				}
-				else {
-					child->size_ratio = 1.0 - (split_ratio * children.size());
-					child->recalcSizePosRecursive(true);
-				}
-				std::cout << "Ratio " << child->size_ratio << " size " << child->size.y << std::endl;
-				this->applyNodeDataToWindow(child, true);
+
+	// windows moving to another container are looked up in the neighbor index,
+	// everything else walks the tree.
+	if (node->data.type == Hy3NodeData::Window && !focusStaysInTree(node, direction)) {
+		target = this->getNeighborFromIndex(node, direction);
+	} else {
+		target = this->shiftOrGetFocus(*node, direction, false, false);
+	}
+
+	if (target == nullptr) {
+		// continue onto the neighboring monitor's visible workspace
+		CMonitor* monitor;
+		int target_workspace;
+		if (!this->getCrossMonitorTarget(node, direction, monitor, target_workspace, target)) return;
+
+		g_pCompositor->focusMonitor(monitor);
+
+		auto* workspace = g_pCompositor->getWorkspaceByID(target_workspace);
+		if (target == nullptr || (workspace != nullptr && workspace->m_bHasFullscreenWindow)) {
+			if (workspace != nullptr && workspace->m_bHasFullscreenWindow) {
+				g_pCompositor->focusWindow(g_pCompositor->getFullscreenWindowOnWorkspace(target_workspace));
+			} else {
+				g_pCompositor->focusWindow(nullptr);
 			}
+
+			g_pCompositor->warpCursorTo(monitor->vecPosition + monitor->vecSize / 2);
+			return;
 		}
+
+		g_pCompositor->warpCursorTo(target->position + target->size / 2);
+	}
+
+	if (target != nullptr) {
+		target->focus();
 	}
 }
 
 void Hy3Layout::shiftWindow(int workspace, ShiftDirection direction, bool once) {
+	Hy3HistoryEdit edit(this, workspace);
+
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	Debug::log(LOG, "ShiftWindow %p %d", node, direction);
 	if (node == nullptr) return;
 
+	// nodes already at the edge of the root group continue onto the neighboring monitor
+	auto* root = this->getWorkspaceRootGroup(workspace);
+	if (root != nullptr && node->parent == root) {
+		auto& group = root->data.as_group;
+		auto at_edge = group.children.size() == 1
+			|| (shiftMatchesLayout(group.layout, direction)
+					&& edgeChild(group, shiftIsForward(direction)) == node);
+
+		CMonitor* monitor;
+		int target_workspace;
+		Hy3Node* entry;
+
+		if (at_edge && this->getCrossMonitorTarget(node, direction, monitor, target_workspace, entry)) {
+			auto* target = g_pCompositor->getWorkspaceByID(target_workspace);
+			if (target == nullptr || target->m_bHasFullscreenWindow) return;
+
+			this->moveNodeToWorkspace(node, target_workspace, entry, shiftIsForward(direction));
+			g_pCompositor->focusMonitor(monitor);
+			node->focus();
+			return;
+		}
+	}
 
 	this->shiftOrGetFocus(*node, direction, true, once);
 }
 
-bool shiftIsForward(ShiftDirection direction) {
-	return direction == ShiftDirection::Right || direction == ShiftDirection::Down;
+CMonitor* Hy3Layout::getMonitorInDirection(CMonitor* monitor, ShiftDirection direction) {
+	auto& adjacency = this->monitor_adjacency;
+
+	auto arrangement_matches = adjacency.arrangement.size() == g_pCompositor->m_vMonitors.size();
+	for (size_t i = 0; arrangement_matches && i < adjacency.arrangement.size(); i++) {
+		auto& m = g_pCompositor->m_vMonitors[i];
+		arrangement_matches = adjacency.arrangement[i] == std::make_tuple(m.get(), m->vecPosition, m->vecSize);
+	}
+
+	if (!arrangement_matches) {
+		Debug::log(LOG, "Monitor arrangement changed, rebuilding monitor adjacency");
+
+		adjacency.arrangement.clear();
+		adjacency.neighbors.clear();
+
+		std::vector<hy3core::Rect> rects;
+
+		for (auto& m: g_pCompositor->m_vMonitors) {
+			adjacency.arrangement.push_back(std::make_tuple(m.get(), m->vecPosition, m->vecSize));
+			rects.push_back({m->vecPosition.x, m->vecPosition.y, m->vecSize.x, m->vecSize.y});
+		}
+
+		auto found = hy3core::findNeighbors(rects);
+
+		for (size_t i = 0; i < found.size(); i++) {
+			auto& neighbors = adjacency.neighbors[g_pCompositor->m_vMonitors[i].get()];
+
+			for (int direction = 0; direction < 4; direction++) {
+				auto neighbor = found[i][direction];
+				neighbors[direction] = neighbor == -1 ? nullptr : g_pCompositor->m_vMonitors[neighbor].get();
+			}
+		}
+	}
+
+	auto neighbors = adjacency.neighbors.find(monitor);
+	if (neighbors == adjacency.neighbors.end()) return nullptr;
+	return neighbors->second[(int) direction];
 }
 
-bool shiftIsVertical(ShiftDirection direction) {
-	return direction == ShiftDirection::Up || direction == ShiftDirection::Down;
+bool Hy3Layout::getCrossMonitorTarget(
+	Hy3Node* node,
+	ShiftDirection direction,
+	CMonitor*& monitor,
+	int& workspace,
+	Hy3Node*& entry
+) {
+	if (this->batch_running) return false;
+
+	auto* current_workspace = g_pCompositor->getWorkspaceByID(node->getWorkspace());
+	if (current_workspace == nullptr) return false;
+
+	auto* current_monitor = g_pCompositor->getMonitorFromID(current_workspace->m_iMonitorID);
+	if (current_monitor == nullptr) return false;
+
+	monitor = this->getMonitorInDirection(current_monitor, direction);
+	if (monitor == nullptr) return false;
+
+	workspace = monitor->specialWorkspaceID != 0 ? monitor->specialWorkspaceID : monitor->activeWorkspace;
+
+	auto center = node->position + node->size / 2;
+	auto along = shiftIsVertical(direction) ? center.x : center.y;
+
+	entry = this->getEdgeWindowFromIndex(workspace, oppositeShift(direction), along);
+	if (entry == nullptr) entry = this->getWorkspaceFocusedNode(workspace);
+
+	return true;
 }
 
-bool shiftMatchesLayout(Hy3GroupLayout layout, ShiftDirection direction) {
-	return (layout == Hy3GroupLayout::SplitV && shiftIsVertical(direction))
-		|| (layout != Hy3GroupLayout::SplitV && !shiftIsVertical(direction));
+static void collectPlaceholders(Hy3Node* node, std::vector<Hy3Node*>& placeholders) {
+	switch (node->data.type) {
+	case Hy3NodeData::Window:
+		if (node->placeholder) placeholders.push_back(node);
+		break;
+	case Hy3NodeData::Group:
+		for (auto* child: node->data.as_group.children) {
+			collectPlaceholders(child, placeholders);
+		}
+		break;
+	}
 }
 
-Hy3Node* Hy3Layout::shiftOrGetFocus(Hy3Node& node, ShiftDirection direction, bool shift, bool once) {
-	auto* break_origin = &node;
-	auto* break_parent = break_origin->parent;
+// nodes take their workspace from the root, only the windows themselves need updating
+static void setWindowsWorkspace(Hy3Node* node, int workspace) {
+	switch (node->data.type) {
+	case Hy3NodeData::Window:
+		// placeholders are cleared before the move, see moveNodeToWorkspace
+		if (!node->placeholder) moveWindowToWorkspace(toWindow(node->data.as_window), workspace);
+		break;
+	case Hy3NodeData::Group:
+		for (auto* child: node->data.as_group.children) {
+			setWindowsWorkspace(child, workspace);
+		}
+		break;
+	}
+}
+
+void Hy3Layout::moveNodeToWorkspace(Hy3Node* node, int workspace, Hy3Node* neighbor, bool before) {
+	Hy3TreePass pass(this);
 
-	auto has_broken_once = false;
+	if (node->parent == nullptr) return;
 
-	// break parents until we hit a container oriented the same way as the shift direction
-	while (true) {
-		if (break_parent == nullptr) return nullptr;
+	auto* target_workspace = g_pCompositor->getWorkspaceByID(workspace);
+	if (target_workspace == nullptr) return;
 
-		auto& group = break_parent->data.as_group; // must be a group in order to be a parent
+	auto* monitor = g_pCompositor->getMonitorFromID(target_workspace->m_iMonitorID);
+	if (monitor == nullptr) return;
 
+	if (neighbor != nullptr && (neighbor->parent == nullptr || neighbor == node)) neighbor = nullptr;
 
-		if (shiftMatchesLayout(group.layout, direction)) {
-			// group has the correct orientation
+	auto origin = node->getWorkspace();
+	Debug::log(LOG, "Moving node %p from workspace %d to %d next to %p", node, origin, workspace, neighbor);
 
-			if (once && shift && has_broken_once) break;
-			if (break_origin != &node) has_broken_once = true;
+	// like hyprland's own movetoworkspace, a moved fullscreen window leaves fullscreen first
+	auto* origin_workspace = g_pCompositor->getWorkspaceByID(origin);
+	if (workspace != origin && origin_workspace != nullptr && origin_workspace->m_bHasFullscreenWindow) {
+		auto* fullscreen = g_pCompositor->getFullscreenWindowOnWorkspace(origin);
+		auto* fullscreen_node = this->getNodeFromWindow(fullscreen);
+		while (fullscreen_node != nullptr && fullscreen_node != node) fullscreen_node = fullscreen_node->parent;
 
-			// if this movement would break out of the group, continue the break loop (do not enter this if)
-			// otherwise break.
-			if ((has_broken_once && once && shift)
-					|| !((!shiftIsForward(direction) && group.children.front() == break_origin)
-							 || (shiftIsForward(direction) && group.children.back() == break_origin)))
-				break;
+		if (fullscreen_node != nullptr) g_pCompositor->setWindowFullscreen(fullscreen, false, FULLSCREEN_FULL);
+	}
+
+	this->markWorkspaceDirty(origin);
+	this->markWorkspaceDirty(workspace);
+
+	// floating windows stay on the origin, so their places in the moved node go away.
+	// the node holds the focused window, removing them never empties it.
+	if (workspace != origin) {
+		std::vector<Hy3Node*> placeholders;
+		collectPlaceholders(node, placeholders);
+
+		for (auto* placeholder: placeholders) {
+			Debug::log(LOG, "Dropping placeholder %p of floating window %p left on workspace %d", placeholder, placeholder->data.as_window, origin);
+			this->removeWindowNode(placeholder);
 		}
+	}
 
-		if (break_parent->parent == nullptr) {
-			if (!shift) return nullptr;
+	auto* old_parent = node->removeFromParentRecursive();
 
-			// if we haven't gone up any levels and the group is in the same direction
-			// there's no reason to wrap the root group.
-			if (shiftMatchesLayout(group.layout, direction)) break;
+	if (old_parent != nullptr) old_parent->recalcSizePosRecursive();
 
-			if (group.layout != Hy3GroupLayout::Tabbed
-				&& group.children.size() == 2
-				&& std::find(group.children.begin(), group.children.end(), &node) != group.children.end()
-			) {
-				group.layout = shiftIsVertical(direction) ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
-			} else {
-				// wrap the root group in another group
-				this->nodes.push_back({
-						.parent = break_parent,
-						.data = shiftIsVertical(direction) ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH,
-						.position = break_parent->position,
-						.size = break_parent->size,
-						.workspace_id = break_parent->workspace_id,
-						.layout = this,
-				});
+	if (workspace != origin) setWindowsWorkspace(node, workspace);
 
-				auto* newChild = &this->nodes.back();
-				Hy3Node::swapData(*break_parent, *newChild);
-				break_parent->data.as_group.children.push_back(newChild);
-				break_parent->data.as_group.group_focused = false;
-				break_parent->data.as_group.focused_child = newChild;
-				break_origin = newChild;
-			}
+	Hy3Node* target_group;
+	if (neighbor != nullptr) {
+		target_group = neighbor->parent;
+	} else if ((target_group = this->getWorkspaceRootGroup(workspace)) == nullptr) {
+		this->nodes.push_back({
+			.data = Hy3GroupLayout::SplitH,
+			.position = monitor->vecPosition + monitor->vecReservedTopLeft,
+			.size = monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight,
+			.workspace_id = workspace,
+			.tree = this,
+		});
 
-			break;
+		target_group = &this->nodes.back();
+		tree_events::created(target_group);
+	}
+
+	auto& children = target_group->data.as_group.children;
+	auto insert = children.end();
+
+	if (neighbor != nullptr) {
+		insert = std::find(children.begin(), children.end(), neighbor);
+		if (!before) insert = std::next(insert);
+	}
+
+	children.insert(insert, node);
+	node->parent = target_group;
+	node->size_ratio = 1.0;
+	tree_events::moved(node);
+	tree_events::ratioChanged(node);
+
+	node->markFocused();
+	target_group->recalcSizePosRecursive();
+}
+
+void Hy3Layout::moveToWorkspace(int origin, int target, bool follow) {
+	if (origin == target) return;
+
+	auto* node = this->getWorkspaceFocusedNode(origin);
+	if (node == nullptr || node->parent == nullptr) return;
+
+	auto* target_workspace = g_pCompositor->getWorkspaceByID(target);
+	if (target_workspace == nullptr) return;
+
+	// nothing is tiled below a fullscreen window, like moving across monitors
+	if (target_workspace->m_bHasFullscreenWindow) {
+		Debug::log(LOG, "Not moving node %p onto workspace %d, it has a fullscreen window", node, target);
+		return;
+	}
+
+	// the origin is the outer edit so it is recorded after normalization
+	Hy3HistoryEdit origin_edit(this, origin);
+	Hy3HistoryEdit target_edit(this, target);
+
+	// land next to whatever is focused on the target, like i3
+	auto* neighbor = this->getWorkspaceFocusedNode(target);
+	this->moveNodeToWorkspace(node, target, neighbor, false);
+
+	if (follow) {
+		// hyprland's own workspace switch, called in process
+		g_pKeybindManager->m_mDispatchers["workspace"]("name:" + target_workspace->m_szName);
+		node->focus();
+	} else {
+		auto* focus = this->getWorkspaceFocusedNode(origin);
+
+		if (focus != nullptr) {
+			focus->focus();
 		} else {
-			break_origin = break_parent;
-			break_parent = break_origin->parent;
+			g_pCompositor->focusWindow(nullptr);
 		}
 	}
+}
 
-	auto& parent_group = break_parent->data.as_group;
-	Hy3Node* target_group = break_parent;
-	std::list<Hy3Node*>::iterator insert;
+static const char* batchStepName(const Hy3BatchStep& step) {
+	switch (step.type) {
+	case Hy3BatchStep::MakeGroup:
+	case Hy3BatchStep::MakeOppositeGroup: return "makegroup";
+	case Hy3BatchStep::MoveWindow: return "movewindow";
+	case Hy3BatchStep::MoveFocus: return "movefocus";
+	case Hy3BatchStep::RaiseFocus: return "raisefocus";
+	}
 
-	if (break_origin == parent_group.children.front() && !shiftIsForward(direction)) {
-		if (!shift) return nullptr;
-		insert = parent_group.children.begin();
-	} else if (break_origin == parent_group.children.back() && shiftIsForward(direction)) {
-		if (!shift) return nullptr;
-		insert = parent_group.children.end();
-	} else {
-		auto& group_data = target_group->data.as_group;
+	return "";
+}
 
-		auto iter = std::find(group_data.children.begin(), group_data.children.end(), break_origin);
-		if (shiftIsForward(direction)) iter = std::next(iter);
-		else iter = std::prev(iter);
+// makegroup on a window already alone in a group of that layout has nothing to do
+static bool isGroupedAs(Hy3Node* node, Hy3GroupLayout layout) {
+	return node != nullptr
+		&& node->parent != nullptr
+		&& node->parent->data.as_group.layout == layout
+		&& node->parent->data.as_group.children.size() == 1;
+}
 
-		if ((*iter)->data.type == Hy3NodeData::Window || (shift && once && has_broken_once)) {
-			if (shift) {
-				if (target_group == node.parent) {
-					if (shiftIsForward(direction)) insert = std::next(iter);
-					else insert = iter;
-				} else {
-					if (shiftIsForward(direction)) insert = iter;
-					else insert = std::next(iter);
-				}
-			} else return *iter;
-		} else {
-			// break into neighboring groups until we hit a window
-			while (true) {
-				target_group = *iter;
-				auto& group_data = target_group->data.as_group;
-
-				if (group_data.children.empty()) return nullptr; // in theory this would never happen
-
-				bool shift_after = false;
-
-				if (shiftMatchesLayout(group_data.layout, direction)) {
-					// if the group has the same orientation as movement pick the last/first child based
-					// on movement direction
-					if (shiftIsForward(direction)) iter = group_data.children.begin();
-					else {
-						iter = std::prev(group_data.children.end());
-						shift_after = true;
-					}
-				} else {
-					if (group_data.focused_child != nullptr) {
-						iter = std::find(group_data.children.begin(), group_data.children.end(), group_data.focused_child);
-						shift_after = true;
-					} else {
-						iter = group_data.children.begin();
-					}
-				}
+bool Hy3Layout::runBatch(int workspace, const std::vector<Hy3BatchStep>& steps, std::string& error) {
+	trace::Span span("runBatch");
+
+	if (this->getWorkspaceRootGroup(workspace) == nullptr) {
+		error = "workspace " + std::to_string(workspace) + " has no tiled windows";
+		return false;
+	}
 
-				if (shift && once) {
-					if (shift_after) insert = std::next(iter);
-					else insert = iter;
+	auto failed = false;
+
+	{
+		// one edit for the whole batch. steps only stage their geometry, clients are
+		// configured once when the edit's pass ends. focus only moves in the tree
+		// until then, see Hy3Layout::focusWindow.
+		Hy3HistoryEdit edit(this, workspace);
+		this->batch_running = true;
+
+		std::unordered_set<CWindow*> staged;
+		for (auto& entry: this->transaction) staged.insert(entry.window);
+
+		auto state = this->captureHistory(workspace);
+
+		for (size_t i = 0; i < steps.size() && !failed; i++) {
+			auto& step = steps[i];
+			auto* focused = this->getWorkspaceFocusedNode(workspace);
+			auto idempotent = false;
+
+			if (focused != nullptr) {
+				switch (step.type) {
+				case Hy3BatchStep::MakeGroup:
+					idempotent = isGroupedAs(focused, step.layout);
+					this->makeGroupOnWorkspace(workspace, step.layout);
+					break;
+				case Hy3BatchStep::MakeOppositeGroup:
+					this->makeOppositeGroupOnWorkspace(workspace);
+					break;
+				case Hy3BatchStep::MoveWindow:
+					this->shiftWindow(workspace, step.direction, step.once);
+					break;
+				case Hy3BatchStep::MoveFocus:
+					this->shiftFocus(workspace, step.direction);
+					break;
+				case Hy3BatchStep::RaiseFocus:
+					this->raiseFocus(workspace);
 					break;
 				}
+			}
 
-				if ((*iter)->data.type == Hy3NodeData::Window) {
-					if (shift) {
-						if (shift_after) insert = std::next(iter);
-						else insert = iter;
-						break;
-					} else {
-						return *iter;
-					}
-				}
+			// later steps see the tree as they would if this one ran on its own
+			if (this->normalize_queued) this->normalizeTrees();
+
+			// a step fails if it had nothing to act on, focus included, unless
+			// there was nothing to do in the first place
+			auto next = this->captureHistory(workspace);
+			if (next == nullptr || (next == state && !idempotent)) {
+				error = "step " + std::to_string(i + 1) + " (" + batchStepName(step) + ") did not change anything";
+				failed = true;
 			}
+
+			state = next;
 		}
-	}
 
-	auto& group_data = target_group->data.as_group;
+		if (failed) {
+			Debug::log(LOG, "Rolling back batch on workspace %d: %s", workspace, error.c_str());
 
-	if (target_group == node.parent) {
-		// nullptr is used as a signal value instead of removing it first to avoid iterator invalidation.
-		auto iter = std::find(group_data.children.begin(), group_data.children.end(), &node);
-		*iter = nullptr;
-		target_group->data.as_group.children.insert(insert, &node);
-		target_group->data.as_group.children.remove(nullptr);
-		target_group->recalcSizePosRecursive();
-	} else {
-		target_group->data.as_group.children.insert(insert, &node);
+			// still deferred, so restoring the focus does not touch the compositor's
+			if (edit.before != nullptr) {
+				this->restoreHistory(workspace, *edit.before);
+				this->captureHistory(workspace);
+			}
 
-		// must happen AFTER `insert` is used
-		auto* old_parent = node.removeFromParentRecursive();
-		node.parent = target_group;
-		node.size_ratio = 1.0;
+			// windows the batch staged are back where they were, nothing is sent to them
+			std::vector<CWindow*> dropped;
+			for (auto& entry: this->transaction) {
+				if (!staged.contains(entry.window)) dropped.push_back(entry.window);
+			}
 
-		if (old_parent != nullptr) old_parent->recalcSizePosRecursive();
-		target_group->recalcSizePosRecursive();
+			for (auto* window: dropped) this->dropTransactionWindow(window);
 
-		auto* target_parent = target_group->parent;
-		while (target_parent != nullptr && Hy3Node::swallowGroups(target_parent)) {
-			target_parent = target_parent->parent;
+			// rolled back, there is nothing to undo
+			edit.before = nullptr;
 		}
 
-		node.markFocused();
-
-		if (target_parent != target_group && target_parent != nullptr)
-			target_parent->recalcSizePosRecursive();
+		this->batch_running = false;
 	}
 
-	return nullptr;
+	if (failed) return false;
+
+	// the compositor's focus moves once, to where the batch left it
+	auto* focused = this->getWorkspaceFocusedNode(workspace);
+	if (focused != nullptr) focused->focus();
+
+	return true;
 }
 
-void Hy3Layout::raiseFocus(int workspace) {
-	auto* node = this->getWorkspaceFocusedNode(workspace);
-	if (node == nullptr) return;
+void Hy3Layout::undo(int workspace) {
+	this->travelHistory(workspace, false);
+}
 
-	if (node->parent != nullptr && node->parent->parent != nullptr) {
-		node->parent->focus();
-		node->parent->updateDecos();
+void Hy3Layout::redo(int workspace) {
+	this->travelHistory(workspace, true);
+}
+
+Hy3HistoryEdit::Hy3HistoryEdit(Hy3Layout* layout, int workspace): layout(layout), workspace(workspace) {
+	this->outer = this->layout->editing_workspaces.insert(workspace).second;
+	if (this->outer) this->before = this->layout->captureHistory(workspace);
+	this->layout->beginPass();
+}
+
+Hy3HistoryEdit::~Hy3HistoryEdit() {
+	// end the pass first so the recorded state includes normalization
+	this->layout->endPass();
+
+	if (!this->outer) return;
+	this->layout->editing_workspaces.erase(this->workspace);
+
+	auto after = this->layout->captureHistory(this->workspace);
+	if (this->before == nullptr || after == this->before) return;
+
+	static const auto* history_size = &HyprlandAPI::getConfigValue(PHANDLE, "plugin:hy3:history_size")->intValue;
+
+	auto& history = this->layout->histories[this->workspace];
+	history.undo.push_back(this->before);
+	history.redo.clear();
+
+	while (history.undo.size() > (size_t) std::max(*history_size, (int64_t) 0)) {
+		history.undo.pop_front();
 	}
 }
 
-bool Hy3Layout::shouldRenderSelected(CWindow* window) {
-	if (window == nullptr) return false;
-	auto* root = this->getWorkspaceRootGroup(window->m_iWorkspaceID);
-	if (root == nullptr || root->data.as_group.focused_child == nullptr) return false;
-	auto* focused = root->getFocusedNode();
-	if (focused == nullptr) return false;
+static std::shared_ptr<const Hy3HistoryNode> captureHistoryNode(
+	Hy3Node* node,
+	const std::shared_ptr<const Hy3HistoryNode>& previous
+) {
+	auto* base = previous != nullptr && previous->id == node->id ? previous.get() : nullptr;
+
+	Hy3HistoryNode capture {
+		.id = node->id,
+		.size_ratio = node->size_ratio,
+		.template_tag = node->data.template_tag,
+	};
 
-	switch (focused->data.type) {
+	switch (node->data.type) {
 	case Hy3NodeData::Window:
-		return false;
-	case Hy3NodeData::Group:
-		auto* node = this->getNodeFromWindow(window);
-		if (node == nullptr) return false;
-		return focused->data.as_group.hasChild(node);
+		capture.is_window = true;
+		break;
+	case Hy3NodeData::Group: {
+		auto& group = node->data.as_group;
+		capture.layout = group.layout;
+		capture.group_focused = group.group_focused;
+
+		for (auto* child: group.children) {
+			std::shared_ptr<const Hy3HistoryNode> child_base;
+
+			if (base != nullptr) {
+				// children are usually where they were last time
+				auto index = capture.children.size();
+				if (index < base->children.size() && base->children[index]->id == child->id) {
+					child_base = base->children[index];
+				} else {
+					for (auto& candidate: base->children) {
+						if (candidate->id == child->id) {
+							child_base = candidate;
+							break;
+						}
+					}
+				}
+			}
+
+			if (child == group.focused_child) capture.focused_child = capture.children.size();
+			capture.children.push_back(captureHistoryNode(child, child_base));
+		}
+	} break;
+	}
+
+	if (base != nullptr
+			&& base->is_window == capture.is_window
+			&& base->layout == capture.layout
+			&& base->size_ratio == capture.size_ratio
+			&& base->group_focused == capture.group_focused
+			&& base->template_tag == capture.template_tag
+			&& base->focused_child == capture.focused_child
+			&& base->children == capture.children)
+	{
+		return previous;
 	}
+
+	return std::make_shared<const Hy3HistoryNode>(std::move(capture));
+}
+
+std::shared_ptr<const Hy3HistoryNode> Hy3Layout::captureHistory(int workspace) {
+	auto* root = this->getWorkspaceRootGroup(workspace);
+	if (root == nullptr) return nullptr;
+
+	auto& history = this->histories[workspace];
+	history.current = captureHistoryNode(root, history.current);
+	return history.current;
+}
+
+void Hy3Layout::travelHistory(int workspace, bool redo) {
+	auto& history = this->histories[workspace];
+	auto& from = redo ? history.redo : history.undo;
+	auto& to = redo ? history.undo : history.redo;
+	if (from.empty()) return;
+
+	auto current = this->captureHistory(workspace);
+	if (current == nullptr) return;
+
+	auto target = from.back();
+	from.pop_back();
+	to.push_back(current);
+
+	Debug::log(LOG, "Restoring %s state of workspace %d", redo ? "redo" : "undo", workspace);
+	this->restoreHistory(workspace, *target);
+	this->captureHistory(workspace);
 }
 
-std::string Hy3Node::debugNode() {
-	std::stringstream buf;
-	std::string addr = "0x" + std::to_string((size_t)this);
-	switch (this->data.type) {
+struct Hy3HistoryRestore {
+	std::unordered_map<uint64_t, Hy3Node*> windows;
+	std::unordered_map<uint64_t, Hy3Node*> groups;
+	// windows in tree order, to place the ones missing from the restored state
+	std::vector<Hy3Node*> window_order;
+};
+
+static void collectHistoryRestore(Hy3Node* node, Hy3HistoryRestore& restore) {
+	// focus history is rebuilt from the restored focus
+	node->mru_prev = nullptr;
+	node->mru_next = nullptr;
+
+	switch (node->data.type) {
 	case Hy3NodeData::Window:
-		buf << "window(";
-		buf << std::hex << this;
-		buf << ") [hypr ";
-		buf << this->data.as_window;
-		buf << "] size ratio: ";
-		buf << this->size_ratio;
+		restore.windows[node->id] = node;
+		restore.window_order.push_back(node);
 		break;
 	case Hy3NodeData::Group:
-		buf << "group(";
-		buf << std::hex << this;
-		buf << ") [";
+		if (node->parent != nullptr) restore.groups[node->id] = node;
 
-		switch (this->data.as_group.layout) {
-		case Hy3GroupLayout::SplitH:
-			buf << "splith";
-			break;
-		case Hy3GroupLayout::SplitV:
-			buf << "splitv";
-			break;
-		case Hy3GroupLayout::Tabbed:
-			buf << "tabs";
-			break;
+		for (auto* child: node->data.as_group.children) {
+			collectHistoryRestore(child, restore);
 		}
+		break;
+	}
+}
 
-		buf << "] size ratio: ";
-		buf << this->size_ratio;
-		for (auto* child: this->data.as_group.children) {
-			buf << "\n|-";
-			if (child == nullptr) {
-				buf << "nullptr";
+static void restoreHistoryChildren(Hy3Node* node, const Hy3HistoryNode& capture, Hy3HistoryRestore& restore) {
+	auto* layout = node->tree;
+	node->data = capture.layout;
+	node->data.template_tag = capture.template_tag;
+
+	auto& group = node->data.as_group;
+	group.group_focused = capture.group_focused;
+
+	for (int i = 0; i < (int) capture.children.size(); i++) {
+		auto& child_capture = *capture.children[i];
+		Hy3Node* child = nullptr;
+
+		if (child_capture.is_window) {
+			// windows closed or moved away since are skipped
+			auto iter = restore.windows.find(child_capture.id);
+			if (iter == restore.windows.end()) continue;
+
+			child = iter->second;
+			restore.windows.erase(iter);
+			child->parent = node;
+			child->size_ratio = child_capture.size_ratio;
+			group.children.push_back(child);
+			tree_events::moved(child);
+		} else {
+			auto iter = restore.groups.find(child_capture.id);
+			auto reused = iter != restore.groups.end();
+
+			if (reused) {
+				child = iter->second;
+				restore.groups.erase(iter);
+				child->parent = node;
+				child->size_ratio = child_capture.size_ratio;
 			} else {
-				// this is terrible
-				for (char c: child->debugNode()) {
-					buf << c;
-					if (c == '\n') buf << "  ";
-				}
+				layout->nodes.push_back({
+					.parent = node,
+					.data = child_capture.layout,
+					.size_ratio = child_capture.size_ratio,
+					.tree = layout,
+				});
+
+				child = &layout->nodes.back();
 			}
+
+			restoreHistoryChildren(child, child_capture, restore);
+
+			if (child->data.as_group.children.empty()) {
+				// existing groups are removed with the other unused ones once everything is placed
+				if (reused) restore.groups[child->id] = child;
+				else layout->nodes.remove(*child);
+				continue;
+			}
+
+			group.children.push_back(child);
+
+			if (reused) tree_events::moved(child);
+			else tree_events::created(child);
+		}
+
+		if (i == capture.focused_child) {
+			group.focused_child = child;
+			child->mruTouch();
+		}
+	}
+
+	if (group.focused_child == nullptr && !group.children.empty()) {
+		group.focused_child = group.children.front();
+	}
+
+	// skipped children leave a gap in the ratios
+	float total = 0.0;
+	for (auto* child: group.children) total += child->size_ratio;
+
+	if (total > 0.0) {
+		auto scale = hy3core::normalizeRatioScale(total, group.children.size());
+
+		for (auto* child: group.children) {
+			child->size_ratio *= scale;
+			tree_events::ratioChanged(child);
+		}
+	}
+}
+
+void Hy3Layout::restoreHistory(int workspace, const Hy3HistoryNode& capture) {
+	auto* root = this->getWorkspaceRootGroup(workspace);
+	if (root == nullptr) return;
+
+	Hy3TreePass pass(this);
+	this->markWorkspaceDirty(workspace);
+
+	// windows keep their nodes, groups are reused by id where possible
+	Hy3HistoryRestore restore;
+	collectHistoryRestore(root, restore);
+	restoreHistoryChildren(root, capture, restore);
+
+	// windows opened since the state was recorded go into the root group
+	auto& root_group = root->data.as_group;
+	for (auto* node: restore.window_order) {
+		if (!restore.windows.contains(node->id)) continue;
+
+		node->parent = root;
+		node->size_ratio = 1.0;
+		root_group.children.push_back(node);
+		tree_events::moved(node);
+	}
+
+	if (root_group.focused_child == nullptr && !root_group.children.empty()) {
+		root_group.focused_child = root_group.children.front();
+	}
+
+	for (auto& [id, group]: restore.groups) {
+		tree_events::removed(group);
+		this->nodes.remove(*group);
+	}
+
+	tree_events::layoutChanged(root);
+	root->recalcSizePosRecursive();
+
+	auto* focused = root->getFocusedNode();
+	if (focused != nullptr) focused->focus();
+}
+
+static void tagTemplateNodes(hy3core::TemplateNode& node) {
+	// tags are never reused, so nodes placed from a replaced template never match the new one
+	static uint64_t last_tag = 0;
+	node.tag = ++last_tag;
+
+	for (auto& child: node.children) {
+		tagTemplateNodes(child);
+	}
+}
+
+bool Hy3Layout::setWorkspaceTemplate(int workspace, const std::string& spec, std::string& error) {
+	hy3core::TemplateNode root;
+	if (!hy3core::parseTemplate(spec, root, error)) return false;
+	tagTemplateNodes(root);
+
+	Debug::log(LOG, "Set template of workspace %d to %s", workspace, spec.c_str());
+	this->templates[workspace] = {.root = std::move(root)};
+	return true;
+}
+
+void Hy3Layout::clearWorkspaceTemplate(int workspace) {
+	this->templates.erase(workspace);
+}
+
+std::unordered_map<uint64_t, Hy3Node*> Hy3Layout::getTemplateNodes(int workspace) {
+	std::unordered_map<uint64_t, Hy3Node*> placed;
+
+	for (auto& node: this->nodes) {
+		if (node.data.template_tag != 0 && node.valid && node.getWorkspace() == workspace) {
+			placed[node.data.template_tag] = &node;
 		}
+	}
 
+	return placed;
+}
+
+// the live node a template node was placed as, if it still exists in the same role
+static Hy3Node* findPlaced(const std::unordered_map<uint64_t, Hy3Node*>& placed, const hy3core::TemplateNode& template_node) {
+	auto iter = placed.find(template_node.tag);
+	if (iter == placed.end()) return nullptr;
+
+	auto* node = iter->second;
+	auto is_group = node->data.type == Hy3NodeData::Group;
+	if (is_group != (template_node.type == hy3core::TemplateNode::Group)) return nullptr;
+
+	return node;
+}
+
+bool Hy3Layout::findTemplateSlot(
+	const std::unordered_map<uint64_t, Hy3Node*>& placed,
+	const hy3core::TemplateNode& template_node,
+	const std::string& window_class,
+	const std::string& title,
+	std::vector<const hy3core::TemplateNode*>& path
+) {
+	path.push_back(&template_node);
+
+	switch (template_node.type) {
+	case hy3core::TemplateNode::Slot:
+		if (findPlaced(placed, template_node) == nullptr
+				&& std::regex_search(template_node.match_title ? title : window_class, template_node.pattern))
+			return true;
+		break;
+	case hy3core::TemplateNode::Group:
+		for (auto& child: template_node.children) {
+			if (this->findTemplateSlot(placed, child, window_class, title, path)) return true;
+		}
 		break;
 	}
 
-	return buf.str();
+	path.pop_back();
+	return false;
+}
+
+bool Hy3Layout::placeFromTemplate(CWindow* window) {
+	auto workspace = window->m_iWorkspaceID;
+
+	auto template_iter = this->templates.find(workspace);
+	if (template_iter == this->templates.end()) return false;
+
+	auto& workspace_template = template_iter->second;
+	auto placed = this->getTemplateNodes(workspace);
+	std::vector<const hy3core::TemplateNode*> path;
+	auto window_class = g_pXWaylandManager->getAppIDClass(window);
+	auto title = g_pXWaylandManager->getTitle(window);
+
+	if (!this->findTemplateSlot(placed, workspace_template.root, window_class, title, path)) return false;
+
+	Hy3TreePass pass(this);
+	auto* monitor = g_pCompositor->getMonitorFromID(window->m_iMonitorID);
+
+	// the highest newly created node and the group it was inserted into
+	Hy3Node* insert_group = nullptr;
+	const hy3core::TemplateNode* insert_template = nullptr;
+	Hy3Node* parent = nullptr;
+
+	for (size_t i = 0; i < path.size(); i++) {
+		auto* template_node = path[i];
+		auto* node = findPlaced(placed, *template_node);
+
+		if (node == nullptr && i == 0) {
+			node = this->getWorkspaceRootGroup(workspace);
+
+			if (node != nullptr && node->data.as_group.layout != template_node->layout) {
+				if (visibleChildCount(node->data.as_group) <= 1) {
+					Debug::log(LOG, "Converting the root of workspace %d to the template's layout", workspace);
+					node->data.as_group.layout = template_node->layout;
+					tree_events::layoutChanged(node);
+				} else {
+					// existing windows keep their arrangement as one group in the template's root
+					Debug::log(LOG, "Wrapping the windows of workspace %d in the template's root layout", workspace);
+					node->intoGroup(template_node->layout);
+				}
+			}
+
+			if (node == nullptr) {
+				this->nodes.push_back({
+					.data = template_node->layout,
+					.position = monitor->vecPosition + monitor->vecReservedTopLeft,
+					.size = monitor->vecSize - monitor->vecReservedTopLeft - monitor->vecReservedBottomRight,
+					.workspace_id = workspace,
+					.tree = this,
+				});
+
+				node = &this->nodes.back();
+				tree_events::created(node);
+			}
+		} else if (node == nullptr) {
+			if (template_node->type == hy3core::TemplateNode::Slot) {
+				this->nodes.push_back({
+					.parent = parent,
+					.data = toHandle(window),
+					.size_ratio = template_node->ratio,
+					.tree = this,
+				});
+			} else {
+				this->nodes.push_back({
+					.parent = parent,
+					.data = template_node->layout,
+					.size_ratio = template_node->ratio,
+					.tree = this,
+				});
+			}
+
+			node = &this->nodes.back();
+
+			// keep template order relative to siblings that were already placed
+			auto& siblings = path[i - 1]->children;
+			auto& children = parent->data.as_group.children;
+			auto insert = children.end();
+
+			for (auto iter = siblings.begin() + (template_node - &siblings.front()) + 1; iter != siblings.end(); iter++) {
+				auto* sibling = findPlaced(placed, *iter);
+				if (sibling == nullptr || sibling->parent != parent) continue;
+
+				insert = std::find(children.begin(), children.end(), sibling);
+				break;
+			}
+
+			children.insert(insert, node);
+			tree_events::created(node);
+
+			if (insert_group == nullptr) {
+				insert_group = parent;
+				insert_template = path[i - 1];
+			}
+		}
+
+		node->data.template_tag = template_node->tag;
+		placed[template_node->tag] = node;
+		parent = node;
+	}
+
+	// the slot is always new, so insert_group is set
+	auto* window_node = parent;
+
+	// template ratios among the placed siblings, other windows in the group keep theirs
+	auto& children = insert_group->data.as_group.children;
+
+	for (auto& template_child: insert_template->children) {
+		auto* child = findPlaced(placed, template_child);
+		if (child != nullptr && child->parent == insert_group) child->size_ratio = template_child.ratio;
+	}
+
+	float total = 0.0;
+	for (auto* child: children) total += child->size_ratio;
+	auto scale = hy3core::normalizeRatioScale(total, children.size());
+
+	for (auto* child: children) {
+		child->size_ratio *= scale;
+		tree_events::ratioChanged(child);
+	}
+
+	Debug::log(LOG, "Placed window %p (class %s) into its template slot on workspace %d", window, window_class.c_str(), workspace);
+
+	window_node->markFocused();
+	insert_group->recalcSizePosRecursive();
+
+	return true;
 }
+
+void Hy3Layout::raiseFocus(int workspace) {
+	auto* node = this->getWorkspaceFocusedNode(workspace);
+	if (node == nullptr) return;
+
+	if (node->parent != nullptr && node->parent->parent != nullptr) {
+		node->parent->focus();
+	}
+}
+
@@ -1,106 +1,157 @@
 #pragma once
 
+#include <array>
+#include <deque>
 #include <list>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <pixman.h>
 #include <hyprland/src/layout/IHyprLayout.hpp>
 
+#include "core/SpatialIndex.hpp"
+#include "core/Template.hpp"
+#include "core/Tree.hpp"
+#include "core/Types.hpp"
+
 class Hy3Layout;
-struct Hy3Node;
 
-enum class Hy3GroupLayout {
-	SplitH,
-	SplitV,
-	Tabbed,
+// Geometric neighbors, edges and point lookups of every visible tiled window
+// on a workspace. Rebuilt at the end of each layout pass that touches the workspace.
+struct Hy3WorkspaceIndex {
+	hy3core::SpatialIndex spatial;
+	// visible windows, in the order they were given to `spatial`
+	std::vector<Hy3Node*> windows;
+	std::unordered_map<Hy3Node*, int> items;
+};
+
+// A window's geometry from a layout pass, held back until every window that was
+// resized in the same transaction has committed a buffer at its new size.
+struct Hy3TransactionEntry {
+	Hy3Layout* layout;
+	CWindow* window;
+	Vector2D position;
+	Vector2D size;
+	bool warp = false;
+	// size the client was last configured with
+	Vector2D configured_size;
+	// configured with a new size and waiting for the client to commit
+	bool waiting = false;
+	// serial of that configure, unused for xwayland clients which are matched by their buffer size
+	uint32_t serial = 0;
+	wl_listener commit_listener;
+};
+
+// Where a dragged window goes if it is dropped at the current pointer position.
+struct Hy3DropTarget {
+	int workspace = -1;
+	// window under the pointer, null to insert into the root group of an empty workspace
+	CWindow* window = nullptr;
+	// edge of `window` to insert the dragged window at, unless tabbing into it
+	ShiftDirection edge = ShiftDirection::Right;
+	bool tab = false;
+	// area the dragged window is shown in until it is dropped
+	Vector2D preview_position;
+	Vector2D preview_size;
+
+	bool operator==(const Hy3DropTarget&) const = default;
 };
 
-enum class ShiftDirection {
-	Left,
-	Up,
-	Down,
-	Right,
+// Neighboring monitors indexed by ShiftDirection, rebuilt only when the
+// monitor arrangement changes.
+struct Hy3MonitorAdjacency {
+	std::vector<std::tuple<CMonitor*, Vector2D, Vector2D>> arrangement;
+	std::unordered_map<CMonitor*, std::array<CMonitor*, 4>> neighbors;
 };
 
-struct Hy3GroupData {
+// Immutable copy of a node recorded for hy3:undo. Unchanged subtrees are shared
+// between the recorded states of a workspace, so an edit only copies the paths it changed.
+struct Hy3HistoryNode {
+	// windows are matched by node id rather than by address, as ids are never
+	// reused while a closed window's address may be taken by a new one
+	uint64_t id;
+	bool is_window = false;
 	Hy3GroupLayout layout = Hy3GroupLayout::SplitH;
-	std::list<Hy3Node*> children;
+	float size_ratio = 1.0;
 	bool group_focused = true;
-	Hy3Node* focused_child = nullptr;
+	uint64_t template_tag = 0;
+	// index into children, -1 if there is none
+	int focused_child = -1;
+	std::vector<std::shared_ptr<const Hy3HistoryNode>> children;
+};
 
-	bool hasChild(Hy3Node* child);
+struct Hy3WorkspaceHistory {
+	// last captured state, new captures share everything unchanged with it
+	std::shared_ptr<const Hy3HistoryNode> current;
+	std::deque<std::shared_ptr<const Hy3HistoryNode>> undo;
+	std::deque<std::shared_ptr<const Hy3HistoryNode>> redo;
+};
 
-	Hy3GroupData(Hy3GroupLayout layout);
+// Layout pass around a user edit of a workspace's tree. If the tree changed,
+// the state before the edit is pushed onto the workspace's undo history.
+// Edits nested in another edit of the same workspace are recorded as part of it.
+struct Hy3HistoryEdit {
+	Hy3Layout* layout;
+	int workspace;
+	// false if nested in another edit of the workspace
+	bool outer;
+	// null if there is nothing to record
+	std::shared_ptr<const Hy3HistoryNode> before;
 
-private:
-	Hy3GroupData(Hy3GroupData&&) = default;
-	Hy3GroupData(const Hy3GroupData&) = default;
+	Hy3HistoryEdit(Hy3Layout*, int workspace);
+	~Hy3HistoryEdit();
 
-	friend class Hy3NodeData;
+	Hy3HistoryEdit(const Hy3HistoryEdit&) = delete;
+	Hy3HistoryEdit& operator=(const Hy3HistoryEdit&) = delete;
 };
 
-class Hy3NodeData {
-public:
-	enum { Group, Window } type;
-	union {
-		Hy3GroupData as_group;
-		CWindow* as_window;
-	};
-
-	bool operator==(const Hy3NodeData&) const;
-
-	Hy3NodeData();
-	~Hy3NodeData();
-	Hy3NodeData(CWindow*);
-	Hy3NodeData(Hy3GroupLayout);
-	Hy3NodeData& operator=(CWindow*);
-	Hy3NodeData& operator=(Hy3GroupLayout);
-
-	//private: - I give up, C++ wins
-	Hy3NodeData(Hy3GroupData);
-	Hy3NodeData(const Hy3NodeData&);
-	Hy3NodeData(Hy3NodeData&&);
-	Hy3NodeData& operator=(const Hy3NodeData&);
+// Template of a workspace, see hy3:template
+struct Hy3WorkspaceTemplate {
+	hy3core::TemplateNode root;
 };
 
-struct Hy3Node {
-	Hy3Node* parent = nullptr;
-	Hy3NodeData data;
-	Vector2D position;
-	Vector2D size;
-	float size_ratio = 1.0;
-	int workspace_id = -1;
-	bool valid = true;
-	Hy3Layout* layout = nullptr;
-
-	void recalcSizePosRecursive(bool force = false);
-	std::string debugNode();
-	void markFocused();
-	void focus();
-	void raiseToTop();
-	Hy3Node* getFocusedNode();
-	void updateDecos();
-
-	bool operator==(const Hy3Node&) const;
-
-	// Attempt to swallow a group. returns true if swallowed
-	static bool swallowGroups(Hy3Node*);
-	// Remove this node from its parent, deleting the parent if it was
-	// the only child and recursing if the parent was the only child of it's parent.
-	Hy3Node* removeFromParentRecursive();
-
-	// Replace this node with a group, returning this node's new address.
-	Hy3Node* intoGroup(Hy3GroupLayout);
-
-	static void swapData(Hy3Node&, Hy3Node&);
+// One operation of hy3:batch
+struct Hy3BatchStep {
+	enum {
+		MakeGroup,
+		MakeOppositeGroup,
+		MoveWindow,
+		MoveFocus,
+		RaiseFocus,
+	} type;
+	Hy3GroupLayout layout = Hy3GroupLayout::SplitH;
+	ShiftDirection direction = ShiftDirection::Left;
+	bool once = false;
 };
 
-class Hy3Layout: public IHyprLayout {
+// The tree stores windows as opaque handles, these convert between the two.
+inline Hy3WindowHandle toHandle(CWindow* window) {
+	return reinterpret_cast<Hy3WindowHandle>(window);
+}
+
+inline CWindow* toWindow(Hy3WindowHandle window) {
+	return reinterpret_cast<CWindow*>(window);
+}
+
+// The hyprland backend of the node tree. Hyprland drives the tree through
+// the IHyprLayout callbacks, and the tree configures windows through this.
+class Hy3Layout: public IHyprLayout, public Hy3TreeBackend, public Hy3Tree {
 public:
+	Hy3Layout();
+	~Hy3Layout();
+
 	virtual void onWindowCreatedTiling(CWindow*);
 	virtual void onWindowRemovedTiling(CWindow*);
+	virtual void onWindowRemovedFloating(CWindow*);
 	virtual void onWindowFocusChange(CWindow*);
 	virtual bool isWindowTiled(CWindow*);
 	virtual void recalculateMonitor(const int&);
 	virtual void recalculateWindow(CWindow*);
 	virtual void onBeginDragWindow();
+	virtual void onMouseMove(const Vector2D&);
+	virtual void onEndDragWindow();
 	virtual void resizeActiveWindow(const Vector2D&, CWindow* pWindow = nullptr);
 	virtual void fullscreenRequestForWindow(CWindow*, eFullscreenMode, bool);
 	virtual std::any layoutMessage(SLayoutMessageHeader, std::string);
@@ -116,18 +167,47 @@ public:
 
 	void makeGroupOnWorkspace(int, Hy3GroupLayout);
 	void makeOppositeGroupOnWorkspace(int);
-	void makeGroupOn(Hy3Node*, Hy3GroupLayout);
-	void makeOppositeGroupOn(Hy3Node*);
 	void shiftWindow(int, ShiftDirection, bool);
 	void shiftFocus(int, ShiftDirection);
 	void raiseFocus(int);
+	// move the focused node of a workspace, along with all of its children, to another workspace
+	void moveToWorkspace(int origin, int target, bool follow);
+	void undo(int workspace);
+	void redo(int workspace);
+	// parse and set the template of a workspace, returns false if the template is invalid
+	bool setWorkspaceTemplate(int workspace, const std::string&, std::string& error);
+	void clearWorkspaceTemplate(int workspace);
+	// run the steps of a hy3:batch as one edit, applying geometry once at the end.
+	// if a step fails the workspace is restored, and false is returned with `error` set.
+	bool runBatch(int workspace, const std::vector<Hy3BatchStep>&, std::string& error);
+
+	// drop the per workspace state of a destroyed workspace. called from hyprland's destroyWorkspace
+	void onWorkspaceDestroyed(int workspace);
+	// mark the nodes of a closing window invalid. called from hyprland's closeWindow
+	// event, before the window is removed from the layout.
+	void onWindowClosed(CWindow*);
 
-	bool shouldRenderSelected(CWindow*);
+	// apply geometry deferred while the workspace was hidden, in one batch.
+	// called when a workspace is about to be shown.
+	void wakeWorkspace(int);
 
-	Hy3Node* getWorkspaceRootGroup(const int&);
-	Hy3Node* getWorkspaceFocusedNode(const int&);
+	using Hy3Tree::getNodeFromWindow;
+	using Hy3Tree::getPlaceholderFromWindow;
+	Hy3Node* getNodeFromWindow(CWindow* window) { return this->Hy3Tree::getNodeFromWindow(toHandle(window)); }
+	Hy3Node* getPlaceholderFromWindow(CWindow* window) { return this->Hy3Tree::getPlaceholderFromWindow(toHandle(window)); }
+
+	// Hy3TreeBackend
+	void beginPass() override;
+	void endPass() override;
+	void applyNodeDataToWindow(Hy3Node*, bool force = false) override;
+	// a batch focuses once it is done, see runBatch
+	void focusWindow(Hy3WindowHandle) override;
+	void raiseWindow(Hy3WindowHandle) override;
+	void markWorkspaceDirty(int) override;
+	void treeChanged(Hy3TreeChange, Hy3Node*) override;
+	Hy3TreeSettings getTreeSettings() override;
+	void log(Hy3LogLevel, const std::string&) override;
 
-	std::list<Hy3Node> nodes;
 private:
 	struct {
 		bool started = false;
@@ -135,14 +215,103 @@ private:
 		bool yExtent = false;
 	} drag_flags;
 
-	int getWorkspaceNodeCount(const int&);
-	Hy3Node* getNodeFromWindow(CWindow*);
-	void applyNodeDataToWindow(Hy3Node*, bool force = false);
+	// tiled window being moved with the mouse. the tree is only changed once it is dropped.
+	struct {
+		CWindow* window = nullptr;
+		Hy3DropTarget target;
+	} drag_move;
+
+	int pass_depth = 0;
+	// nodes with valid cleared, purged when the outermost pass begins
+	size_t invalid_nodes = 0;
+	// workspaces whose geometry or structure changed during the current pass
+	std::unordered_set<int> dirty_workspaces;
+	// set for changes not covered by dirty_workspaces, such as focus
+	bool tree_changed = false;
+	// hidden or fullscreen workspaces with nodes waiting for their geometry to be applied
+	std::unordered_set<int> hibernated_workspaces;
+	// old and new areas of every window moved during the current pass
+	pixman_region32_t pass_damage;
+	// geometry applied together once resized clients commit. a list so
+	// commit listeners keep their address.
+	std::list<Hy3TransactionEntry> transaction;
+	size_t transaction_waiting = 0;
+	wl_event_source* transaction_timer = nullptr;
+	std::unordered_map<int, Hy3WorkspaceIndex> workspace_indexes;
+	// workspaces whose index is rebuilt on its next lookup
+	std::unordered_set<int> stale_indexes;
+	Hy3MonitorAdjacency monitor_adjacency;
+	std::unordered_map<int, Hy3WorkspaceHistory> histories;
+	// workspaces with a Hy3HistoryEdit in progress
+	std::unordered_set<int> editing_workspaces;
+	// set while a hy3:batch runs. its steps stay on the batch's workspace,
+	// so they act as if there was no neighboring monitor.
+	bool batch_running = false;
+	std::unordered_map<int, Hy3WorkspaceTemplate> templates;
+	// windows inside a focused group, drawn with the active border through
+	// requestRenderHints. only rebuilt when the tree or focus changes.
+	std::unordered_set<CWindow*> selected_windows;
+
+	// put a window back into the placeholder it left when it was floated, returns false if it has none
+	bool retilePlaceholder(CWindow*);
+	// remove a window node and relayout what is left of its parent.
+	// does not touch the window, which may already be gone.
+	void removeWindowNode(Hy3Node*);
+	void purgeInvalidNodes();
+	// recompute selected_windows and update the decorations of windows that entered or left it
+	void updateSelectedWindows();
+	// stage the geometry of a window in the current transaction. the client is
+	// configured once the transaction is flushed.
+	void stageWindowGeometry(CWindow*, const Vector2D& position, const Vector2D& size, bool warp);
+	// configure every client with its final staged size, then apply the transaction
+	// if no client is being waited on, otherwise start its timeout
+	void flushTransaction();
+	void applyTransaction();
+	// forget a removed window's staged geometry
+	void dropTransactionWindow(CWindow*);
+	static void onTransactionCommit(wl_listener*, void*);
+	static int onTransactionTimeout(void*);
+	// damage the current and new area of a window that is about to move
+	void damageWindowMove(CWindow*, const Vector2D& position, const Vector2D& size);
+	void rebuildWorkspaceIndex(int);
+	// get the index of a workspace, rebuilding it if the workspace changed since it was built
+	Hy3WorkspaceIndex* getWorkspaceIndex(int);
+	Hy3Node* getNeighborFromIndex(Hy3Node*, ShiftDirection);
+	// get the visible window containing a point on a workspace
+	Hy3Node* getNodeAtFromIndex(int workspace, const Vector2D&);
+	bool getDropTarget(CWindow* dragged, const Vector2D& mouse, Hy3DropTarget&);
+	// move a dragged window to a drop target, returns false if it stays where it was
+	bool dropWindow(CWindow*, const Hy3DropTarget&);
+	// get the window on the given edge of a workspace closest to the given
+	// position along that edge.
+	Hy3Node* getEdgeWindowFromIndex(int workspace, ShiftDirection edge, double along);
+
+	CMonitor* getMonitorInDirection(CMonitor*, ShiftDirection);
+	// Find the monitor in the given direction of the node, and the window on it
+	// closest to the node along the shared edge. Returns false if there is no monitor.
+	bool getCrossMonitorTarget(Hy3Node*, ShiftDirection, CMonitor*&, int& workspace, Hy3Node*& entry);
+	// Move a non root node and its children onto a workspace next to `neighbor`,
+	// or into the root group if `neighbor` is null.
+	void moveNodeToWorkspace(Hy3Node*, int workspace, Hy3Node* neighbor, bool before);
+
+	// capture the tree of a workspace, sharing unchanged nodes with the last capture
+	std::shared_ptr<const Hy3HistoryNode> captureHistory(int workspace);
+	// restore the last undo (or redo) state, pushing the current state onto the other stack
+	void travelHistory(int workspace, bool redo);
+	void restoreHistory(int workspace, const Hy3HistoryNode&);
+
+	// place a new window into the first free matching slot of its workspace's
+	// template with a single relayout. returns false if there is no such slot.
+	bool placeFromTemplate(CWindow*);
+	bool findTemplateSlot(const std::unordered_map<uint64_t, Hy3Node*>& placed, const hy3core::TemplateNode&, const std::string& window_class, const std::string& title, std::vector<const hy3core::TemplateNode*>& path);
+	// nodes of the workspace placed from a template, by template tag
+	std::unordered_map<uint64_t, Hy3Node*> getTemplateNodes(int workspace);
 
-	// if shift is true, shift the window in the given direction, returning nullptr,
-	// if shift is false, return the window in the given direction or nullptr.
-	// if once is true, only one group will be broken out of / into
-	Hy3Node* shiftOrGetFocus(Hy3Node&, ShiftDirection, bool, bool);
+	// the window's box inside a tile once borders, gaps and decorations are taken out.
+	// false if the window fills the tile undecorated, with the tile's own box.
+	bool getTileBox(Hy3Node*, CMonitor*, Vector2D& position, Vector2D& size);
+	// apply the geometry of all nodes under the given node which have geometry_pending set
+	void applyPendingGeometry(Hy3Node*);
 
-	friend struct Hy3Node;
+	friend struct Hy3HistoryEdit;
 };
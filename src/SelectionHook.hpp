@@ -1,7 +0,0 @@
-#pragma once
-
-namespace selection_hook {
-	void init();
-	void enable();
-	void disable();
-}
@@ -0,0 +1,150 @@
+#include "globals.hpp"
+#include "TreeEvents.hpp"
+#include "core/Stats.hpp"
+
+#include <hyprland/src/Compositor.hpp>
+#include <hyprland/src/managers/EventManager.hpp>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+namespace tree_events {
+	static uint64_t g_Generation = 0;
+	static std::vector<SHyprIPCEvent> g_Pending;
+	static std::map<uint64_t, float> g_PendingRatios;
+	static std::map<int, uint64_t> g_PendingFocus;
+	static std::unordered_set<uint64_t> g_Removed;
+
+	static const char* layoutName(Hy3GroupLayout layout) {
+		switch (layout) {
+		case Hy3GroupLayout::SplitH: return "splith";
+		case Hy3GroupLayout::SplitV: return "splitv";
+		case Hy3GroupLayout::Tabbed: return "tabs";
+		case Hy3GroupLayout::Accordion: return "accordion";
+		}
+
+		return "";
+	}
+
+	static void queue(const char* event, std::stringstream& data) {
+		g_Pending.push_back(SHyprIPCEvent{event, data.str()});
+	}
+
+	// every tree mutation passes through here, so it is also where they are counted
+	static void countMutation() {
+		stats::count(stats::Counter::TreeMutations);
+	}
+
+	// fields common to created and moved: workspace, parent and position in the parent
+	static void writePlacement(std::stringstream& data, Hy3Node* node) {
+		data << node->getWorkspace() << ',';
+
+		if (node->parent == nullptr) {
+			data << 0;
+		} else {
+			data << node->parent->id;
+		}
+	}
+
+	void created(Hy3Node* node) {
+		countMutation();
+		std::stringstream data;
+		data << g_Generation + 1 << ',' << node->id << ',';
+		writePlacement(data, node);
+
+		switch (node->data.type) {
+		case Hy3NodeData::Window:
+			data << ",window," << std::hex << (uintptr_t) node->data.as_window;
+			break;
+		case Hy3NodeData::Group:
+			data << ",group," << layoutName(node->data.as_group.layout);
+			break;
+		}
+
+		queue("hy3created", data);
+	}
+
+	void removed(Hy3Node* node) {
+		countMutation();
+		g_Removed.insert(node->id);
+
+		std::stringstream data;
+		data << g_Generation + 1 << ',' << node->id;
+		queue("hy3removed", data);
+	}
+
+	void moved(Hy3Node* node) {
+		countMutation();
+		std::stringstream data;
+		data << g_Generation + 1 << ',' << node->id << ',';
+		writePlacement(data, node);
+
+		size_t index = 0;
+		if (node->parent != nullptr) {
+			auto& children = node->parent->data.as_group.children;
+			index = std::distance(children.begin(), std::find(children.begin(), children.end(), node));
+		}
+
+		data << ',' << index;
+		queue("hy3moved", data);
+	}
+
+	void layoutChanged(Hy3Node* node) {
+		if (node->data.type != Hy3NodeData::Group) return;
+		countMutation();
+
+		std::stringstream data;
+		data << g_Generation + 1 << ',' << node->id << ',' << layoutName(node->data.as_group.layout);
+		queue("hy3layout", data);
+	}
+
+	void ratioChanged(Hy3Node* node) {
+		countMutation();
+		g_PendingRatios[node->id] = node->size_ratio;
+	}
+
+	void focusChanged(Hy3Node* node) {
+		g_PendingFocus[node->getWorkspace()] = node->id;
+	}
+
+	bool flush() {
+		for (auto& [id, ratio]: g_PendingRatios) {
+			if (g_Removed.contains(id)) continue;
+
+			std::stringstream data;
+			data << g_Generation + 1 << ',' << id << ',' << ratio;
+			queue("hy3ratio", data);
+		}
+
+		for (auto& [workspace, id]: g_PendingFocus) {
+			if (g_Removed.contains(id)) continue;
+
+			std::stringstream data;
+			data << g_Generation + 1 << ',' << workspace << ',' << id;
+			queue("hy3focus", data);
+		}
+
+		g_PendingRatios.clear();
+		g_PendingFocus.clear();
+		g_Removed.clear();
+
+		if (g_Pending.empty()) return false;
+
+		g_Generation++;
+
+		for (auto& event: g_Pending) {
+			g_pEventManager->postEvent(event);
+		}
+
+		g_pEventManager->postEvent(SHyprIPCEvent{"hy3commit", std::to_string(g_Generation)});
+		g_Pending.clear();
+
+		return true;
+	}
+
+	uint64_t generation() {
+		return g_Generation;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+struct Hy3Node;
+
+// Incremental tree change events posted on hyprland's event socket (socket2).
+// Events are queued while a layout pass runs and posted together when the
+// outermost pass ends, followed by `hy3commit`. Every event of a batch carries
+// the same generation, which is also written to the tree snapshot.
+//
+//  hy3created>>GEN,ID,WORKSPACE,PARENT,window,ADDRESS
+//  hy3created>>GEN,ID,WORKSPACE,PARENT,group,LAYOUT
+//  hy3removed>>GEN,ID
+//  hy3moved>>GEN,ID,WORKSPACE,PARENT,INDEX
+//  hy3layout>>GEN,ID,LAYOUT
+//  hy3ratio>>GEN,ID,RATIO
+//  hy3focus>>GEN,WORKSPACE,ID
+//  hy3commit>>GEN
+//
+// IDs are stable for the lifetime of a node, PARENT is 0 for root groups.
+namespace tree_events {
+	void created(Hy3Node*);
+	void removed(Hy3Node*);
+	void moved(Hy3Node*);
+	void layoutChanged(Hy3Node*);
+	// ratio changes and focus changes are coalesced, only the last value in a batch is posted
+	void ratioChanged(Hy3Node*);
+	void focusChanged(Hy3Node*);
+
+	// post all queued events, returns true if anything was posted
+	bool flush();
+	uint64_t generation();
+}
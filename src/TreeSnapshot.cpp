@@ -0,0 +1,205 @@
+#include "globals.hpp"
+#include "TreeEvents.hpp"
+#include "TreeSnapshot.hpp"
+
+#include <hyprland/src/plugins/PluginAPI.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <map>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace tree_snapshot {
+	static int g_Fd = -1;
+	static void* g_Region = nullptr;
+	static std::string g_LinkPath;
+
+	void init() {
+		g_Fd = memfd_create("hy3-tree", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		if (g_Fd < 0) {
+			Debug::log(ERR, "hy3: failed to create tree snapshot memfd: %s", strerror(errno));
+			return;
+		}
+
+		if (ftruncate(g_Fd, CAPACITY) != 0) {
+			Debug::log(ERR, "hy3: failed to size tree snapshot memfd: %s", strerror(errno));
+			deinit();
+			return;
+		}
+
+		fcntl(g_Fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+		g_Region = mmap(nullptr, CAPACITY, PROT_READ | PROT_WRITE, MAP_SHARED, g_Fd, 0);
+		if (g_Region == MAP_FAILED) {
+			g_Region = nullptr;
+			Debug::log(ERR, "hy3: failed to map tree snapshot memfd: %s", strerror(errno));
+			deinit();
+			return;
+		}
+
+		new(g_Region) Header {
+			.magic = MAGIC,
+			.version = VERSION,
+			.flags = 0,
+			.sequence = 0,
+			.capacity = CAPACITY,
+			.workspace_count = 0,
+			.node_count = 0,
+			.generation = 0,
+		};
+
+		const auto* instance = getenv("HYPRLAND_INSTANCE_SIGNATURE");
+		if (instance == nullptr) return;
+
+		g_LinkPath = std::string("/tmp/hypr/") + instance + "/hy3-tree";
+		auto target = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(g_Fd);
+
+		std::error_code ec;
+		std::filesystem::remove(g_LinkPath, ec);
+		std::filesystem::create_symlink(target, g_LinkPath, ec);
+
+		if (ec) {
+			Debug::log(ERR, "hy3: failed to link tree snapshot at %s: %s", g_LinkPath.c_str(), ec.message().c_str());
+			g_LinkPath.clear();
+		}
+	}
+
+	static void writeNode(
+		Hy3Node* node,
+		uint32_t parent,
+		Hy3Node* focused,
+		Node* nodes,
+		uint32_t& count,
+		uint32_t max_nodes,
+		bool& truncated
+	) {
+		if (count == max_nodes) {
+			truncated = true;
+			return;
+		}
+
+		auto index = count++;
+		auto& out = nodes[index];
+
+		out = Node {
+			.id = node->id,
+			.window = 0,
+			.parent = parent,
+			.focused_child = NONE,
+			.child_count = 0,
+			.type = 0,
+			.layout = 0,
+			.flags = (uint8_t) (node == focused ? FOCUSED : 0),
+			._pad = {},
+			.size_ratio = node->size_ratio,
+			.x = (float) node->position.x,
+			.y = (float) node->position.y,
+			.width = (float) node->size.x,
+			.height = (float) node->size.y,
+		};
+
+		switch (node->data.type) {
+		case Hy3NodeData::Window:
+			out.window = (uint64_t) (uintptr_t) node->data.as_window;
+			if (node->placeholder) out.flags |= PLACEHOLDER;
+			break;
+		case Hy3NodeData::Group: {
+			auto& group = node->data.as_group;
+			out.type = 1;
+			out.layout = (uint8_t) group.layout;
+			if (group.group_focused) out.flags |= GROUP_FOCUSED;
+
+			for (auto* child: group.children) {
+				// only children that fit are counted, so readers never index past the written nodes
+				if (count == max_nodes) {
+					truncated = true;
+					break;
+				}
+
+				// children are written right after their parent, so the index is known up front
+				if (child == group.focused_child) out.focused_child = count;
+				out.child_count++;
+				writeNode(child, index, focused, nodes, count, max_nodes, truncated);
+			}
+		} break;
+		}
+	}
+
+	void publish(Hy3Layout& layout) {
+		if (g_Region == nullptr) return;
+
+		// sorted so workspaces are listed in a stable order
+		std::map<int, Hy3Node*> roots;
+		for (auto& node: layout.nodes) {
+			if (node.parent == nullptr && node.data.type == Hy3NodeData::Group) {
+				roots[node.workspace_id] = &node;
+			}
+		}
+
+		auto* header = (Header*) g_Region;
+		auto* workspaces = (Workspace*) (header + 1);
+
+		auto max_workspaces = std::min(roots.size(), (CAPACITY - sizeof(Header)) / sizeof(Workspace));
+		auto* nodes = (Node*) (workspaces + max_workspaces);
+		auto max_nodes = (uint32_t) ((CAPACITY - sizeof(Header) - max_workspaces * sizeof(Workspace)) / sizeof(Node));
+
+		auto sequence = header->sequence.load(std::memory_order_relaxed);
+		header->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		uint32_t workspace_count = 0;
+		uint32_t node_count = 0;
+		bool truncated = roots.size() > max_workspaces;
+
+		for (auto& [id, root]: roots) {
+			if (workspace_count == max_workspaces) break;
+
+			auto first = node_count;
+			writeNode(root, NONE, root->getFocusedNode(), nodes, node_count, max_nodes, truncated);
+			if (node_count == first) break;
+
+			auto focused = NONE;
+			for (auto i = first; i < node_count; i++) {
+				if (nodes[i].flags & FOCUSED) {
+					focused = i;
+					break;
+				}
+			}
+
+			workspaces[workspace_count++] = Workspace {
+				.id = id,
+				.root = first,
+				.node_count = node_count - first,
+				.focused = focused,
+			};
+		}
+
+		header->flags = truncated ? TRUNCATED : 0;
+		header->workspace_count = workspace_count;
+		header->node_count = node_count;
+		header->generation = tree_events::generation();
+
+		header->sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	void deinit() {
+		if (!g_LinkPath.empty()) {
+			std::error_code ec;
+			std::filesystem::remove(g_LinkPath, ec);
+			g_LinkPath.clear();
+		}
+
+		if (g_Region != nullptr) {
+			munmap(g_Region, CAPACITY);
+			g_Region = nullptr;
+		}
+
+		if (g_Fd >= 0) {
+			close(g_Fd);
+			g_Fd = -1;
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+class Hy3Layout;
+
+// Compact binary snapshot of every workspace tree, published in a memfd backed
+// shared memory region linked at /tmp/hypr/$HYPRLAND_INSTANCE_SIGNATURE/hy3-tree.
+//
+// The region starts with a Header, followed by `workspace_count` Workspaces and
+// `node_count` Nodes. Nodes of each workspace are stored in pre-order.
+// `sequence` is a seqlock: it is odd while the snapshot is being rewritten.
+// Readers should wait for an even value, copy what they need, and retry if
+// `sequence` changed in the meantime.
+namespace tree_snapshot {
+	inline constexpr uint32_t MAGIC = 0x54335948; // "HY3T"
+	inline constexpr uint16_t VERSION = 2;
+	inline constexpr uint32_t CAPACITY = 1 << 20;
+	inline constexpr uint32_t NONE = UINT32_MAX;
+
+	enum HeaderFlags: uint16_t {
+		// not every node fit in the region
+		TRUNCATED = 1 << 0,
+	};
+
+	enum NodeFlags: uint8_t {
+		// the group itself is selected, rather than one of its children
+		GROUP_FOCUSED = 1 << 0,
+		// the focused node of its workspace
+		FOCUSED = 1 << 1,
+		// a floating window's place in the tree. it takes no space until the window is tiled again.
+		PLACEHOLDER = 1 << 2,
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t flags;
+		std::atomic<uint32_t> sequence;
+		uint32_t capacity;
+		uint32_t workspace_count;
+		uint32_t node_count;
+		// generation of the last tree_events batch included in the snapshot
+		uint64_t generation;
+	};
+
+	struct Workspace {
+		int32_t id;
+		// index of the workspace's root node
+		uint32_t root;
+		uint32_t node_count;
+		// index of the focused node, or NONE
+		uint32_t focused;
+	};
+
+	struct Node {
+		// stable node id, matching the ids used by tree events
+		uint64_t id;
+		// window address as shown by `hyprctl clients`, 0 for groups
+		uint64_t window;
+		// index of the parent node, or NONE for the root
+		uint32_t parent;
+		// index of the group's focused child, or NONE
+		uint32_t focused_child;
+		// children written to the snapshot, fewer than the group has if it is truncated
+		uint16_t child_count;
+		// 0 = window, 1 = group
+		uint8_t type;
+		// Hy3GroupLayout of groups
+		uint8_t layout;
+		uint8_t flags;
+		uint8_t _pad[3];
+		float size_ratio;
+		float x, y, width, height;
+	};
+
+	static_assert(std::atomic<uint32_t>::is_always_lock_free);
+	static_assert(sizeof(Header) == 32);
+	static_assert(sizeof(Workspace) == 16);
+	static_assert(sizeof(Node) == 56);
+
+	void init();
+	// rewrite the snapshot from the current state of the layout
+	void publish(Hy3Layout&);
+	void deinit();
+}
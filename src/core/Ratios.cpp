@@ -0,0 +1,25 @@
+#include <algorithm>
+
+#include "Ratios.hpp"
+
+namespace hy3core {
+	double ratioTradeChange(double ratio, double neighbor_ratio, double target, double minimum) {
+		return std::clamp(target - ratio, minimum - ratio, neighbor_ratio - minimum);
+	}
+
+	double removalRatioShift(double removed_ratio, size_t remaining) {
+		if (remaining == 0) return 0.0;
+		return -((1.0 - removed_ratio) / remaining);
+	}
+
+	void mergeRatioScales(size_t siblings, size_t merged, double ratio, double& sibling_scale, double& child_scale) {
+		double merged_count = siblings - 1 + merged;
+		sibling_scale = merged_count / siblings;
+		child_scale = ratio / merged * sibling_scale;
+	}
+
+	double normalizeRatioScale(double total, size_t count) {
+		if (total <= 0.0) return 1.0;
+		return count / total;
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// Size ratio math of split groups. 1.0 is an even share, the ratios
+// of a group's children add up to the number of children.
+namespace hy3core {
+	// change to apply to a ratio, and the opposite to its neighbor's, to bring it
+	// as close to `target` as possible without either going below `minimum`
+	double ratioTradeChange(double ratio, double neighbor_ratio, double target, double minimum = 0.1);
+
+	// added to the ratio of each of `remaining` siblings of a removed node
+	double removalRatioShift(double removed_ratio, size_t remaining);
+
+	// scales applied when a group with `merged` children and the given ratio is
+	// spliced into its parent of `siblings` children (including the group), so
+	// every node keeps its size
+	void mergeRatioScales(size_t siblings, size_t merged, double ratio, double& sibling_scale, double& child_scale);
+
+	// multiplier bringing `count` ratios that add up to `total` back to adding up to `count`
+	double normalizeRatioScale(double total, size_t count);
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+
+#include "SpatialIndex.hpp"
+
+namespace hy3core {
+	bool sticks(double a, double b) {
+		return std::abs(a - b) < 2;
+	}
+
+	bool directionalDistance(const Rect& from, const Rect& to, ShiftDirection direction, double& gap, double& offset) {
+		auto from_right = from.x + from.w;
+		auto from_bottom = from.y + from.h;
+		auto to_right = to.x + to.w;
+		auto to_bottom = to.y + to.h;
+		auto from_center_x = from.x + from.w / 2;
+		auto from_center_y = from.y + from.h / 2;
+		auto to_center_x = to.x + to.w / 2;
+		auto to_center_y = to.y + to.h / 2;
+
+		bool overlap_x = to.x < from_right - 1 && to_right > from.x + 1;
+		bool overlap_y = to.y < from_bottom - 1 && to_bottom > from.y + 1;
+
+		switch (direction) {
+		case ShiftDirection::Left:
+			if (!overlap_y || to_right > from.x + 1) return false;
+			gap = from.x - to_right;
+			offset = std::abs(to_center_y - from_center_y);
+			break;
+		case ShiftDirection::Right:
+			if (!overlap_y || to.x < from_right - 1) return false;
+			gap = to.x - from_right;
+			offset = std::abs(to_center_y - from_center_y);
+			break;
+		case ShiftDirection::Up:
+			if (!overlap_x || to_bottom > from.y + 1) return false;
+			gap = from.y - to_bottom;
+			offset = std::abs(to_center_x - from_center_x);
+			break;
+		case ShiftDirection::Down:
+			if (!overlap_x || to.y < from_bottom - 1) return false;
+			gap = to.y - from_bottom;
+			offset = std::abs(to_center_x - from_center_x);
+			break;
+		}
+
+		return true;
+	}
+
+	std::vector<std::array<int, 4>> findNeighbors(const std::vector<Rect>& rects) {
+		std::vector<std::array<int, 4>> result(rects.size());
+
+		for (size_t item = 0; item < rects.size(); item++) {
+			auto& neighbors = result[item];
+			neighbors.fill(-1);
+
+			double best_gap[4];
+			double best_offset[4];
+
+			for (size_t other = 0; other < rects.size(); other++) {
+				if (other == item) continue;
+
+				for (int i = 0; i < 4; i++) {
+					double gap;
+					double offset;
+
+					if (!directionalDistance(rects[item], rects[other], (ShiftDirection) i, gap, offset)) continue;
+
+					// prefer the closest edge, then the rect most in line with this one
+					if (neighbors[i] == -1
+							|| gap < best_gap[i] - 1
+							|| (gap < best_gap[i] + 1 && offset < best_offset[i]))
+					{
+						neighbors[i] = other;
+						best_gap[i] = gap;
+						best_offset[i] = offset;
+					}
+				}
+			}
+		}
+
+		return result;
+	}
+
+	void SpatialIndex::build(const Rect& root, std::vector<Rect> items) {
+		this->items = std::move(items);
+		this->neighbors = findNeighbors(this->items);
+
+		for (auto& edge: this->edges) {
+			edge.clear();
+		}
+
+		for (int i = 0; i < (int) this->items.size(); i++) {
+			auto& item = this->items[i];
+
+			if (sticks(item.x, root.x)) this->edges[(int) ShiftDirection::Left].push_back(i);
+			if (sticks(item.x + item.w, root.x + root.w)) this->edges[(int) ShiftDirection::Right].push_back(i);
+			if (sticks(item.y, root.y)) this->edges[(int) ShiftDirection::Up].push_back(i);
+			if (sticks(item.y + item.h, root.y + root.h)) this->edges[(int) ShiftDirection::Down].push_back(i);
+		}
+
+		auto by_y = [&](int a, int b) { return this->items[a].y < this->items[b].y; };
+		auto by_x = [&](int a, int b) { return this->items[a].x < this->items[b].x; };
+
+		std::sort(this->edges[(int) ShiftDirection::Left].begin(), this->edges[(int) ShiftDirection::Left].end(), by_y);
+		std::sort(this->edges[(int) ShiftDirection::Right].begin(), this->edges[(int) ShiftDirection::Right].end(), by_y);
+		std::sort(this->edges[(int) ShiftDirection::Up].begin(), this->edges[(int) ShiftDirection::Up].end(), by_x);
+		std::sort(this->edges[(int) ShiftDirection::Down].begin(), this->edges[(int) ShiftDirection::Down].end(), by_x);
+
+		this->grid.assign(GRID_SIZE * GRID_SIZE, {});
+		this->grid_x = root.x;
+		this->grid_y = root.y;
+		this->cell_w = root.w / GRID_SIZE;
+		this->cell_h = root.h / GRID_SIZE;
+		if (this->cell_w <= 0 || this->cell_h <= 0) return;
+
+		auto cell = [&](double value, double origin, double size) {
+			return std::clamp((int) ((value - origin) / size), 0, GRID_SIZE - 1);
+		};
+
+		for (int i = 0; i < (int) this->items.size(); i++) {
+			auto& item = this->items[i];
+			auto x0 = cell(item.x, this->grid_x, this->cell_w);
+			auto x1 = cell(item.x + item.w, this->grid_x, this->cell_w);
+			auto y0 = cell(item.y, this->grid_y, this->cell_h);
+			auto y1 = cell(item.y + item.h, this->grid_y, this->cell_h);
+
+			for (auto y = y0; y <= y1; y++) {
+				for (auto x = x0; x <= x1; x++) {
+					this->grid[y * GRID_SIZE + x].push_back(i);
+				}
+			}
+		}
+	}
+
+	void SpatialIndex::clear() {
+		this->items.clear();
+		this->neighbors.clear();
+		this->grid.clear();
+
+		for (auto& edge: this->edges) {
+			edge.clear();
+		}
+	}
+
+	int SpatialIndex::neighbor(int item, ShiftDirection direction) const {
+		if (item < 0 || item >= (int) this->neighbors.size()) return -1;
+		return this->neighbors[item][(int) direction];
+	}
+
+	int SpatialIndex::itemAt(double x, double y) const {
+		if (this->grid.empty() || this->cell_w <= 0 || this->cell_h <= 0) return -1;
+
+		auto cell_x = (int) std::floor((x - this->grid_x) / this->cell_w);
+		auto cell_y = (int) std::floor((y - this->grid_y) / this->cell_h);
+		if (cell_x < 0 || cell_y < 0 || cell_x >= GRID_SIZE || cell_y >= GRID_SIZE) return -1;
+
+		for (auto i: this->grid[cell_y * GRID_SIZE + cell_x]) {
+			auto& item = this->items[i];
+			if (x >= item.x && x < item.x + item.w && y >= item.y && y < item.y + item.h) return i;
+		}
+
+		return -1;
+	}
+
+	int SpatialIndex::edgeItemNear(ShiftDirection edge, double along) const {
+		auto& items = this->edges[(int) edge];
+		if (items.empty()) return -1;
+
+		bool vertical_edge = edge == ShiftDirection::Left || edge == ShiftDirection::Right;
+		auto start = [&](int i) { return vertical_edge ? this->items[i].y : this->items[i].x; };
+		auto end = [&](int i) { return start(i) + (vertical_edge ? this->items[i].h : this->items[i].w); };
+
+		// items along an edge never overlap, so the last one starting before `along` is the only one that can contain it.
+		auto iter = std::upper_bound(items.begin(), items.end(), along, [&](double value, int i) {
+			return value < start(i);
+		});
+
+		if (iter == items.begin()) return *iter;
+
+		auto before = *std::prev(iter);
+		if (iter == items.end() || along <= end(before)) return before;
+
+		return along - end(before) <= start(*iter) - along ? before : *iter;
+	}
+}
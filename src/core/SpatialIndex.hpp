@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace hy3core {
+	struct Rect {
+		double x = 0;
+		double y = 0;
+		double w = 0;
+		double h = 0;
+	};
+
+	// true if two coordinates are close enough to count as the same edge
+	bool sticks(double a, double b);
+
+	// Get how far `to` is past the `direction` edge of `from` (gap) and how far their centers are
+	// offset along that edge. Returns false if `to` does not share any of that edge with `from`.
+	bool directionalDistance(const Rect& from, const Rect& to, ShiftDirection direction, double& gap, double& offset);
+
+	// Closest rect in each ShiftDirection for every rect, preferring the closest
+	// edge, then the rect most in line. -1 where there is none.
+	std::vector<std::array<int, 4>> findNeighbors(const std::vector<Rect>&);
+
+	// Geometric neighbors, edges and a point lookup grid over non overlapping
+	// rects inside a root rect. Items are referred to by their index in the
+	// vector the index was built from.
+	class SpatialIndex {
+	public:
+		// cells per axis of the point lookup grid
+		static constexpr int GRID_SIZE = 8;
+
+		void build(const Rect& root, std::vector<Rect> items);
+		void clear();
+
+		// -1 if there is none
+		int neighbor(int item, ShiftDirection) const;
+		// item containing a point, -1 if there is none
+		int itemAt(double x, double y) const;
+		// item on an edge of the root closest to a position along that edge, -1 if the edge is empty
+		int edgeItemNear(ShiftDirection edge, double along) const;
+
+	private:
+		std::vector<Rect> items;
+		std::vector<std::array<int, 4>> neighbors;
+		// items touching each edge of the root, sorted along the edge
+		std::array<std::vector<int>, 4> edges;
+		double grid_x = 0;
+		double grid_y = 0;
+		double cell_w = 0;
+		double cell_h = 0;
+		// each cell lists the items overlapping it
+		std::vector<std::vector<int>> grid;
+	};
+}
@@ -0,0 +1,121 @@
+#include "Stats.hpp"
+
+#include <bit>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace stats {
+	static const char* counterName(Counter counter) {
+		switch (counter) {
+		case Counter::LayoutPasses: return "layout passes";
+		case Counter::NodesVisited: return "nodes visited";
+		case Counter::ConfiguresSent: return "configures sent";
+		case Counter::DamageCalls: return "damage calls";
+		case Counter::TreeMutations: return "tree mutations";
+		case Counter::LiveNodes: return "live nodes";
+		case Counter::PeakNodes: return "peak nodes";
+		case Counter::Count: break;
+		}
+
+		return "";
+	}
+
+	static const char* timingName(Timing timing) {
+		switch (timing) {
+		case Timing::OnWindowCreatedTiling: return "onWindowCreatedTiling";
+		case Timing::OnWindowRemovedTiling: return "onWindowRemovedTiling";
+		case Timing::OnWindowFocusChange: return "onWindowFocusChange";
+		case Timing::RecalculateMonitor: return "recalculateMonitor";
+		case Timing::RecalculateWindow: return "recalculateWindow";
+		case Timing::ResizeActiveWindow: return "resizeActiveWindow";
+		case Timing::FullscreenRequestForWindow: return "fullscreenRequestForWindow";
+		case Timing::LayoutMessage: return "layoutMessage";
+		case Timing::RequestRenderHints: return "requestRenderHints";
+		case Timing::SwitchWindows: return "switchWindows";
+		case Timing::AlterSplitRatio: return "alterSplitRatio";
+		case Timing::GetNextWindowCandidate: return "getNextWindowCandidate";
+		case Timing::ReplaceWindowDataWith: return "replaceWindowDataWith";
+		case Timing::OnEnable: return "onEnable";
+		case Timing::OnDisable: return "onDisable";
+		case Timing::DispatchMakeGroup: return "hy3:makegroup";
+		case Timing::DispatchMoveFocus: return "hy3:movefocus";
+		case Timing::DispatchMoveWindow: return "hy3:movewindow";
+		case Timing::DispatchRaiseFocus: return "hy3:raisefocus";
+		case Timing::DispatchDebugNodes: return "hy3:debugnodes";
+		case Timing::DispatchMoveToWorkspace: return "hy3:movetoworkspace";
+		case Timing::DispatchUndo: return "hy3:undo";
+		case Timing::DispatchRedo: return "hy3:redo";
+		case Timing::DispatchTemplate: return "hy3:template";
+		case Timing::DispatchBatch: return "hy3:batch";
+		case Timing::Count: break;
+		}
+
+		return "";
+	}
+
+	void setNodeCount(uint64_t nodes) {
+		g_Counters[(int) Counter::LiveNodes] = nodes;
+
+		if (nodes > g_Counters[(int) Counter::PeakNodes]) {
+			g_Counters[(int) Counter::PeakNodes] = nodes;
+		}
+	}
+
+	void record(Timing timing, uint64_t ns) {
+		auto& histogram = g_Histograms[(int) timing];
+		auto bucket = std::min((int) std::bit_width(ns), HISTOGRAM_BUCKETS - 1);
+
+		histogram.count++;
+		histogram.total_ns += ns;
+		histogram.buckets[bucket]++;
+		if (ns > histogram.max_ns) histogram.max_ns = ns;
+	}
+
+	// upper bound of the bucket containing the given percentile
+	static uint64_t percentile(const Histogram& histogram, double percentile) {
+		auto target = (uint64_t) (histogram.count * percentile);
+		uint64_t seen = 0;
+
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+			seen += histogram.buckets[i];
+			if (seen > target) return std::min((uint64_t) 1 << i, histogram.max_ns);
+		}
+
+		return histogram.max_ns;
+	}
+
+	std::string dump() {
+		std::stringstream buf;
+		buf << std::fixed << std::setprecision(1);
+
+		for (int i = 0; i < (int) Counter::Count; i++) {
+			buf << counterName((Counter) i) << ": " << g_Counters[i] << "\n";
+		}
+
+		buf << "latency (us):";
+
+		for (int i = 0; i < (int) Timing::Count; i++) {
+			auto& histogram = g_Histograms[i];
+			if (histogram.count == 0) continue;
+
+			buf << "\n" << timingName((Timing) i) << " - count " << histogram.count
+				<< ", mean " << histogram.total_ns / histogram.count / 1000.0
+				<< ", p50 " << percentile(histogram, 0.5) / 1000.0
+				<< ", p99 " << percentile(histogram, 0.99) / 1000.0
+				<< ", max " << histogram.max_ns / 1000.0;
+		}
+
+		return buf.str();
+	}
+
+	void reset() {
+		auto live = g_Counters[(int) Counter::LiveNodes];
+
+		std::memset(g_Counters, 0, sizeof(g_Counters));
+		std::memset(g_Histograms, 0, sizeof(g_Histograms));
+
+		g_Counters[(int) Counter::LiveNodes] = live;
+		g_Counters[(int) Counter::PeakNodes] = live;
+	}
+}
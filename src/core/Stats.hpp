@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Always-on counters and latency histograms, dumped with `hy3:stats`.
+namespace stats {
+	enum class Counter {
+		LayoutPasses,
+		NodesVisited,
+		ConfiguresSent,
+		DamageCalls,
+		TreeMutations,
+		LiveNodes,
+		PeakNodes,
+		Count,
+	};
+
+	enum class Timing {
+		// IHyprLayout callbacks
+		OnWindowCreatedTiling,
+		OnWindowRemovedTiling,
+		OnWindowFocusChange,
+		RecalculateMonitor,
+		RecalculateWindow,
+		ResizeActiveWindow,
+		FullscreenRequestForWindow,
+		LayoutMessage,
+		RequestRenderHints,
+		SwitchWindows,
+		AlterSplitRatio,
+		GetNextWindowCandidate,
+		ReplaceWindowDataWith,
+		OnEnable,
+		OnDisable,
+		// dispatchers
+		DispatchMakeGroup,
+		DispatchMoveFocus,
+		DispatchMoveWindow,
+		DispatchRaiseFocus,
+		DispatchDebugNodes,
+		DispatchMoveToWorkspace,
+		DispatchUndo,
+		DispatchRedo,
+		DispatchTemplate,
+		DispatchBatch,
+		Count,
+	};
+
+	// log2 buckets of nanoseconds, the last bucket holds everything slower
+	inline constexpr int HISTOGRAM_BUCKETS = 32;
+
+	struct Histogram {
+		uint64_t count;
+		uint64_t total_ns;
+		uint64_t max_ns;
+		uint64_t buckets[HISTOGRAM_BUCKETS];
+	};
+
+	inline uint64_t g_Counters[(int) Counter::Count] = {};
+	inline Histogram g_Histograms[(int) Timing::Count] = {};
+
+	inline void count(Counter counter, uint64_t amount = 1) {
+		g_Counters[(int) counter] += amount;
+	}
+
+	// update live node count and peak node count
+	void setNodeCount(uint64_t);
+	void record(Timing, uint64_t ns);
+
+	// records the time from construction to destruction
+	struct Timer {
+		Timing timing;
+		std::chrono::steady_clock::time_point start;
+
+		Timer(Timing timing): timing(timing), start(std::chrono::steady_clock::now()) {}
+
+		~Timer() {
+			auto elapsed = std::chrono::steady_clock::now() - this->start;
+			record(this->timing, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		}
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+	};
+
+	std::string dump();
+	// reset everything except the live node count
+	void reset();
+}
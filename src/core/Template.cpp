@@ -0,0 +1,121 @@
+#include <cctype>
+#include <cstdlib>
+
+#include "Template.hpp"
+
+namespace hy3core {
+	static bool parseTemplateNode(
+		const std::vector<std::string>& tokens,
+		size_t& i,
+		TemplateNode& node,
+		std::string& error
+	) {
+		if (i >= tokens.size()) {
+			error = "unexpected end of template";
+			return false;
+		}
+
+		auto token = tokens[i++];
+
+		// optional `<ratio>*` prefix
+		if (!token.empty() && (std::isdigit((unsigned char) token[0]) || token[0] == '.')) {
+			auto star = token.find('*');
+			if (star == std::string::npos) {
+				error = "expected '*' after ratio in '" + token + "'";
+				return false;
+			}
+
+			char* end;
+			node.ratio = std::strtof(token.c_str(), &end);
+			if (end != token.c_str() + star || node.ratio <= 0.0) {
+				error = "invalid ratio in '" + token + "'";
+				return false;
+			}
+
+			token = token.substr(star + 1);
+		}
+
+		if (token.starts_with("class:") || token.starts_with("title:")) {
+			node.type = TemplateNode::Slot;
+			node.match_title = token.starts_with("title:");
+
+			try {
+				node.pattern = std::regex(token.substr(6));
+			} catch (const std::regex_error& e) {
+				error = "invalid pattern in '" + token + "': " + e.what();
+				return false;
+			}
+
+			return true;
+		}
+
+		if (token == "h") node.layout = Hy3GroupLayout::SplitH;
+		else if (token == "v") node.layout = Hy3GroupLayout::SplitV;
+		else if (token == "tabbed") node.layout = Hy3GroupLayout::Tabbed;
+		else if (token == "accordion") node.layout = Hy3GroupLayout::Accordion;
+		else {
+			error = "unknown group layout or slot '" + token + "'";
+			return false;
+		}
+
+		if (i >= tokens.size() || tokens[i] != "[") {
+			error = "expected '[' after '" + token + "'";
+			return false;
+		}
+
+		i++;
+
+		while (i < tokens.size() && tokens[i] != "]") {
+			node.children.emplace_back();
+			if (!parseTemplateNode(tokens, i, node.children.back(), error)) return false;
+		}
+
+		if (i >= tokens.size()) {
+			error = "missing ']' after '" + token + "'";
+			return false;
+		}
+
+		i++;
+
+		if (node.children.empty()) {
+			error = "empty group '" + token + "'";
+			return false;
+		}
+
+		return true;
+	}
+
+	bool parseTemplate(const std::string& spec, TemplateNode& root, std::string& error) {
+		// brackets are tokens of their own, everything else is split on whitespace
+		std::vector<std::string> tokens;
+		std::string token;
+
+		for (auto c: spec) {
+			if (std::isspace((unsigned char) c) || c == '[' || c == ']') {
+				if (!token.empty()) tokens.push_back(std::move(token));
+				token.clear();
+				if (c == '[' || c == ']') tokens.push_back(std::string(1, c));
+			} else {
+				token += c;
+			}
+		}
+
+		if (!token.empty()) tokens.push_back(std::move(token));
+
+		size_t i = 0;
+
+		if (!parseTemplateNode(tokens, i, root, error)) return false;
+
+		if (i != tokens.size()) {
+			error = "unexpected '" + tokens[i] + "' after the root group";
+			return false;
+		}
+
+		if (root.type != TemplateNode::Group) {
+			error = "the root of a template must be a group";
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace hy3core {
+	// Workspace layout given with hy3:template. A window matching a free slot is
+	// placed straight into it, creating the groups above the slot the first time
+	// one of their slots fills.
+	struct TemplateNode {
+		enum { Group, Slot } type = Group;
+		Hy3GroupLayout layout = Hy3GroupLayout::SplitH;
+		float ratio = 1.0;
+		// slots match the window class, or the title if match_title is set
+		bool match_title = false;
+		std::regex pattern;
+		// identifies the nodes placed from this one, set by the template's user
+		uint64_t tag = 0;
+		std::vector<TemplateNode> children;
+	};
+
+	// parse a template such as `h[ 2*class:firefox v[ class:kitty title:.*vim ] ]`.
+	// returns false and sets `error` if it is invalid.
+	bool parseTemplate(const std::string& spec, TemplateNode& root, std::string& error);
+}
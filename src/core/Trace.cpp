@@ -0,0 +1,50 @@
+#include "Trace.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+
+namespace trace {
+	void start() {
+		g_Enabled.store(false, std::memory_order_relaxed);
+
+		if (g_Events == nullptr) {
+			g_Events = new Event[CAPACITY];
+		}
+
+		g_Head.store(0, std::memory_order_relaxed);
+		g_Enabled.store(true, std::memory_order_relaxed);
+	}
+
+	void stop() {
+		g_Enabled.store(false, std::memory_order_relaxed);
+	}
+
+	bool dump(const std::string& path) {
+		if (g_Events == nullptr) return false;
+
+		std::ofstream out(path);
+		if (!out) return false;
+
+		auto head = g_Head.load(std::memory_order_relaxed);
+		auto first = head > CAPACITY ? head - CAPACITY : 0;
+		auto pid = getpid();
+
+		out << std::fixed << std::setprecision(3);
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+		for (auto i = first; i < head; i++) {
+			auto& event = g_Events[i % CAPACITY];
+			if (i != first) out << ',';
+
+			// chrome trace timestamps are in microseconds
+			out << "{\"name\":\"" << event.name
+				<< "\",\"cat\":\"hy3\",\"ph\":\"X\",\"ts\":" << event.start_ns / 1000.0
+				<< ",\"dur\":" << event.duration_ns / 1000.0
+				<< ",\"pid\":" << pid << ",\"tid\":" << pid << '}';
+		}
+
+		out << "]}\n";
+		return out.good();
+	}
+}
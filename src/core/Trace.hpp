@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+// Opt-in span tracing into a fixed size ring buffer, dumped as Chrome trace JSON
+// which can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+// Timestamps are CLOCK_MONOTONIC, matching Hyprland's own frame timing.
+namespace trace {
+	inline constexpr uint64_t CAPACITY = 1 << 16;
+
+	struct Event {
+		const char* name;
+		uint64_t start_ns;
+		uint64_t duration_ns;
+	};
+
+	inline std::atomic<bool> g_Enabled = false;
+	inline Event* g_Events = nullptr;
+	inline std::atomic<uint64_t> g_Head = 0;
+
+	inline uint64_t now() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
+
+	// records a span from construction to destruction while tracing is enabled.
+	// `name` must be a string literal.
+	struct Span {
+		const char* name;
+		uint64_t start_ns = 0;
+
+		Span(const char* name): name(name) {
+			if (g_Enabled.load(std::memory_order_relaxed)) this->start_ns = now();
+		}
+
+		~Span() {
+			if (this->start_ns == 0 || !g_Enabled.load(std::memory_order_relaxed)) return;
+
+			auto slot = g_Head.fetch_add(1, std::memory_order_relaxed) % CAPACITY;
+			g_Events[slot] = Event {
+				.name = this->name,
+				.start_ns = this->start_ns,
+				.duration_ns = now() - this->start_ns,
+			};
+		}
+
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+	};
+
+	// clear the buffer and start recording
+	void start();
+	void stop();
+	// write the recorded spans to `path` as Chrome trace JSON. returns false on failure.
+	bool dump(const std::string& path);
+}
@@ -0,0 +1,1173 @@
+#include "Tree.hpp"
+#include "Ratios.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+
+Hy3TreePass::Hy3TreePass(Hy3Tree* tree): tree(tree) {
+	this->tree->backend.beginPass();
+}
+
+Hy3TreePass::~Hy3TreePass() {
+	this->tree->backend.endPass();
+}
+
+Hy3GroupData::Hy3GroupData(Hy3GroupLayout layout): layout(layout) {}
+
+Hy3NodeData::Hy3NodeData(): Hy3NodeData((Hy3WindowHandle)nullptr) {}
+
+Hy3NodeData::Hy3NodeData(Hy3WindowHandle window): type(Hy3NodeData::Window) {
+	this->as_window = window;
+}
+
+Hy3NodeData::Hy3NodeData(Hy3GroupData group): type(Hy3NodeData::Group) {
+	new(&this->as_group) Hy3GroupData(std::move(group));
+}
+
+Hy3NodeData::Hy3NodeData(Hy3GroupLayout layout): Hy3NodeData(Hy3GroupData(layout)) {}
+
+Hy3NodeData::~Hy3NodeData() {
+	switch (this->type) {
+	case Hy3NodeData::Window:
+		break;
+	case Hy3NodeData::Group:
+		this->as_group.~Hy3GroupData();
+
+		// who ever thought calling the dtor after a move was a good idea?
+		this->type = Hy3NodeData::Window;
+		break;
+	}
+}
+
+Hy3NodeData::Hy3NodeData(const Hy3NodeData& from): type(from.type), template_tag(from.template_tag) {
+	switch (from.type) {
+	case Hy3NodeData::Window:
+		this->as_window = from.as_window;
+		break;
+	case Hy3NodeData::Group:
+		new(&this->as_group) Hy3GroupData(from.as_group);
+		break;
+	}
+}
+
+Hy3NodeData::Hy3NodeData(Hy3NodeData&& from): type(from.type), template_tag(from.template_tag) {
+	switch (from.type) {
+	case Hy3NodeData::Window:
+		this->as_window = from.as_window;
+		break;
+	case Hy3NodeData::Group:
+		new(&this->as_group) Hy3GroupData(std::move(from.as_group));
+		break;
+	}
+}
+
+Hy3NodeData& Hy3NodeData::operator=(const Hy3NodeData& from) {
+	if (this->type == Hy3NodeData::Group) {
+		this->as_group.~Hy3GroupData();
+	}
+
+	this->type = from.type;
+	this->template_tag = from.template_tag;
+
+	switch (this->type) {
+	case Hy3NodeData::Window:
+		this->as_window = from.as_window;
+		break;
+	case Hy3NodeData::Group:
+		new(&this->as_group) Hy3GroupData(from.as_group);
+		break;
+	}
+
+	return *this;
+}
+
+Hy3NodeData& Hy3NodeData::operator=(Hy3NodeData&& from) {
+	if (this->type == Hy3NodeData::Group) {
+		this->as_group.~Hy3GroupData();
+	}
+
+	this->type = from.type;
+	this->template_tag = from.template_tag;
+
+	switch (this->type) {
+	case Hy3NodeData::Window:
+		this->as_window = from.as_window;
+		break;
+	case Hy3NodeData::Group:
+		new(&this->as_group) Hy3GroupData(std::move(from.as_group));
+		break;
+	}
+
+	return *this;
+}
+
+Hy3NodeData& Hy3NodeData::operator=(Hy3WindowHandle window) {
+	*this = Hy3NodeData(window);
+
+	return *this;
+}
+
+Hy3NodeData& Hy3NodeData::operator=(Hy3GroupLayout layout) {
+	*this = Hy3NodeData(layout);
+
+	return *this;
+}
+
+bool Hy3NodeData::operator==(const Hy3NodeData& rhs) const {
+	return this == &rhs;
+}
+
+bool Hy3Node::operator==(const Hy3Node& rhs) const {
+	return this->data == rhs.data;
+}
+
+void Hy3Node::recalcSizePosRecursive(bool force) {
+	trace::Span span("recalcSizePosRecursive");
+	Hy3TreePass pass(this->tree);
+	stats::count(stats::Counter::NodesVisited);
+
+	if (this->data.type != Hy3NodeData::Group) {
+		if (!this->placeholder) this->tree->backend.applyNodeDataToWindow(this, force);
+		return;
+	}
+
+	auto* group = &this->data.as_group;
+
+	if (group->children.size() == 1 && this->parent != nullptr) {
+		auto child = group->children.front();
+
+		if (child == this) {
+			this->tree->log(Hy3LogLevel::Critical, "a group (%p) has become its own child", this);
+		}
+
+		double distortOut;
+		double distortIn;
+
+		auto settings = this->tree->backend.getTreeSettings();
+
+		if (settings.gaps_in > settings.gaps_out) {
+			distortOut = settings.gaps_out - 1.0;
+		} else {
+			distortOut = settings.gaps_in - 1.0;
+		}
+
+		if (distortOut < 0) distortOut = 0.0;
+
+		distortIn = settings.gaps_in * 2;
+
+		switch (group->layout) {
+		case Hy3GroupLayout::SplitH:
+			child->position.x = this->position.x - distortOut;
+			child->size.x = this->size.x - distortIn;
+			child->position.y = this->position.y;
+			child->size.y = this->size.y;
+			break;
+		case Hy3GroupLayout::SplitV:
+		case Hy3GroupLayout::Accordion:
+			child->position.y = this->position.y - distortOut;
+			child->size.y = this->size.y - distortIn;
+			child->position.x = this->position.x;
+			child->size.x = this->size.x;
+			break;
+		case Hy3GroupLayout::Tabbed:
+			// TODO
+			break;
+		}
+
+		child->recalcSizePosRecursive(force);
+		return;
+	}
+
+	int constraint;
+	switch (group->layout) {
+	case Hy3GroupLayout::SplitH:
+		constraint = this->size.x;
+		break;
+	case Hy3GroupLayout::SplitV:
+	case Hy3GroupLayout::Accordion:
+		constraint = this->size.y;
+		break;
+	case Hy3GroupLayout::Tabbed:
+		break;
+	}
+
+	// placeholders of floating windows take no space
+	double ratio_total = 0;
+	int visible_count = 0;
+
+	for (auto* child: group->children) {
+		if (child->isCollapsed()) continue;
+		ratio_total += child->size_ratio;
+		visible_count++;
+	}
+
+	double ratio_mul = group->layout != Hy3GroupLayout::Tabbed ? ratio_total <= 0 ? 0 : constraint / ratio_total : 0;
+
+	double offset = 0;
+
+	// accordions ignore size ratios, the focused child takes all space not used by collapsed children.
+	Hy3Node* expanded_child = nullptr;
+	double collapsed_size = 0;
+	double expanded_size = 0;
+
+	if (group->layout == Hy3GroupLayout::Accordion && !group->children.empty()) {
+		auto settings = this->tree->backend.getTreeSettings();
+
+		expanded_child = group->focused_child;
+		if (expanded_child == nullptr || expanded_child->isCollapsed()) {
+			auto iter = std::find_if(group->children.begin(), group->children.end(), [](auto* child) {
+				return !child->isCollapsed();
+			});
+
+			expanded_child = iter != group->children.end() ? *iter : nullptr;
+		}
+
+		if (visible_count != 0) {
+			collapsed_size = std::min((double) settings.accordion_collapsed_size, (double) constraint / visible_count);
+			expanded_size = constraint - collapsed_size * (visible_count - 1);
+		}
+	}
+
+	for(auto child: group->children) {
+		if (child->isCollapsed()) {
+			switch (group->layout) {
+			case Hy3GroupLayout::SplitH:
+				child->position = hy3core::Vec2(this->position.x + offset, this->position.y);
+				child->size = hy3core::Vec2(0, this->size.y);
+				break;
+			case Hy3GroupLayout::SplitV:
+			case Hy3GroupLayout::Accordion:
+				child->position = hy3core::Vec2(this->position.x, this->position.y + offset);
+				child->size = hy3core::Vec2(this->size.x, 0);
+				break;
+			case Hy3GroupLayout::Tabbed:
+				break;
+			}
+
+			continue;
+		}
+
+		switch (group->layout) {
+		case Hy3GroupLayout::SplitH:
+			child->position.x = this->position.x + offset;
+			child->size.x = child->size_ratio * ratio_mul;
+			offset += child->size.x;
+			child->position.y = this->position.y;
+			child->size.y = this->size.y;
+			break;
+		case Hy3GroupLayout::SplitV:
+			child->position.y = this->position.y + offset;
+			child->size.y = child->size_ratio * ratio_mul;
+			offset += child->size.y;
+			child->position.x = this->position.x;
+			child->size.x = this->size.x;
+			break;
+		case Hy3GroupLayout::Tabbed:
+			// TODO: tab bars
+			child->position = this->position;
+			child->size = this->size;
+			break;
+		case Hy3GroupLayout::Accordion:
+			child->position.y = this->position.y + offset;
+			child->size.y = child == expanded_child ? expanded_size : collapsed_size;
+			offset += child->size.y;
+			child->position.x = this->position.x;
+			child->size.x = this->size.x;
+			break;
+		}
+
+		child->recalcSizePosRecursive(force);
+	}
+}
+
+int Hy3Node::getWorkspace() {
+	auto* root = this;
+	while (root->parent != nullptr) root = root->parent;
+	return root->workspace_id;
+}
+
+void Hy3Node::markFocused() {
+	trace::Span span("markFocused");
+	Hy3TreePass pass(this->tree);
+	Hy3Node* node = this;
+
+	// update focus
+	if (this->data.type == Hy3NodeData::Group) {
+		this->data.as_group.group_focused = true;
+
+		// accordions keep their expanded child while selected as a whole
+		if (this->data.as_group.layout != Hy3GroupLayout::Accordion) {
+			this->data.as_group.focused_child = nullptr;
+		}
+	}
+
+	this->tree->backend.treeChanged(Hy3TreeChange::FocusChanged, this);
+
+	// outermost accordion whose expanded child changed, relaying it out covers any nested ones.
+	Hy3Node* accordion = nullptr;
+
+	while (node->parent != nullptr) {
+		auto& group = node->parent->data.as_group;
+
+		if (group.focused_child != node) {
+			switch (group.layout) {
+			case Hy3GroupLayout::Tabbed:
+				// switching tabs changes which windows are visible
+				this->tree->backend.markWorkspaceDirty(this->getWorkspace());
+				break;
+			case Hy3GroupLayout::Accordion:
+				accordion = node->parent;
+				break;
+			default:
+				break;
+			}
+		}
+
+		group.focused_child = node;
+		group.group_focused = false;
+		node->mruTouch();
+		node = node->parent;
+	}
+
+	if (accordion != nullptr) {
+		accordion->recalcSizePosRecursive();
+	}
+}
+
+void Hy3Node::focus() {
+	this->markFocused();
+
+	switch (this->data.type) {
+	case Hy3NodeData::Window:
+		this->tree->backend.focusWindow(this->data.as_window);
+		break;
+	case Hy3NodeData::Group:
+		this->tree->backend.focusWindow(nullptr);
+		this->raiseToTop();
+		break;
+	}
+}
+
+void Hy3Node::raiseToTop() {
+	switch (this->data.type) {
+	case Hy3NodeData::Window:
+		this->tree->backend.raiseWindow(this->data.as_window);
+		break;
+	case Hy3NodeData::Group:
+		for (auto* child: this->data.as_group.children) {
+			child->raiseToTop();
+		}
+		break;
+	}
+}
+
+Hy3Node* Hy3Node::getFocusedNode() {
+	switch (this->data.type) {
+	case Hy3NodeData::Window:
+		return this;
+	case Hy3NodeData::Group:
+		if (this->data.as_group.focused_child == nullptr || this->data.as_group.group_focused) {
+			return this;
+		} else {
+			return this->data.as_group.focused_child->getFocusedNode();
+		}
+	}
+}
+
+bool Hy3Node::isCollapsed() {
+	switch (this->data.type) {
+	case Hy3NodeData::Window:
+		return this->placeholder;
+	case Hy3NodeData::Group:
+		if (this->data.as_group.children.empty()) return false;
+
+		for (auto* child: this->data.as_group.children) {
+			if (!child->isCollapsed()) return false;
+		}
+
+		return true;
+	}
+}
+
+bool Hy3Node::mruLinked() {
+	if (this->parent == nullptr) return false;
+	return this->mru_prev != nullptr || this->parent->data.as_group.mru_head == this;
+}
+
+void Hy3Node::mruUnlink() {
+	if (!this->mruLinked()) return;
+
+	if (this->mru_prev != nullptr) this->mru_prev->mru_next = this->mru_next;
+	else this->parent->data.as_group.mru_head = this->mru_next;
+	if (this->mru_next != nullptr) this->mru_next->mru_prev = this->mru_prev;
+
+	this->mru_prev = nullptr;
+	this->mru_next = nullptr;
+}
+
+void Hy3Node::mruTouch() {
+	if (this->parent == nullptr) return;
+	auto& group = this->parent->data.as_group;
+	if (group.mru_head == this) return;
+
+	this->mruUnlink();
+	this->mru_next = group.mru_head;
+	if (group.mru_head != nullptr) group.mru_head->mru_prev = this;
+	group.mru_head = this;
+}
+
+// first or last child of a group that takes space, null if there is none
+Hy3Node* edgeChild(Hy3GroupData& group, bool last) {
+	if (last) {
+		for (auto iter = group.children.rbegin(); iter != group.children.rend(); ++iter) {
+			if (!(*iter)->isCollapsed()) return *iter;
+		}
+	} else {
+		for (auto* child: group.children) {
+			if (!child->isCollapsed()) return child;
+		}
+	}
+
+	return nullptr;
+}
+
+// number of children of a group that take space
+size_t visibleChildCount(Hy3GroupData& group) {
+	return std::count_if(group.children.begin(), group.children.end(), [](auto* child) { return !child->isCollapsed(); });
+}
+
+// closest sibling after (or before) a node that takes space, null if there is none
+Hy3Node* visibleSibling(Hy3Node* node, bool forward) {
+	auto& children = node->parent->data.as_group.children;
+	auto iter = std::find(children.begin(), children.end(), node);
+
+	if (forward) {
+		for (iter++; iter != children.end(); iter++) {
+			if (!(*iter)->isCollapsed()) return *iter;
+		}
+	} else {
+		while (iter != children.begin()) {
+			if (!(*--iter)->isCollapsed()) return *iter;
+		}
+	}
+
+	return nullptr;
+}
+
+// most recently focused child of a group that still takes space, null if none was focused
+Hy3Node* mruVisibleChild(Hy3GroupData& group) {
+	for (auto* mru = group.mru_head; mru != nullptr; mru = mru->mru_next) {
+		if (!mru->isCollapsed()) return mru;
+	}
+
+	return nullptr;
+}
+
+bool Hy3Node::swallowGroups(Hy3Node* into) {
+	if (into == nullptr
+			|| into->data.type != Hy3NodeData::Group
+			|| into->data.as_group.children.size() != 1)
+		return false;
+
+	auto* child = into->data.as_group.children.front();
+
+	// a lot of segfaulting happens once the assumption that the root node is a group is wrong.
+	if (into->parent == nullptr && child->data.type != Hy3NodeData::Group) return false;
+
+	into->tree->log(Hy3LogLevel::Log, "Swallowing %p into %p", child, into);
+	into->tree->backend.markWorkspaceDirty(into->getWorkspace());
+
+	// the child list is moved, not copied. `into` takes over the child's id like swapData.
+	into->data = std::move(child->data);
+	std::swap(into->id, child->id);
+
+	for (auto* grandchild: into->data.as_group.children) {
+		grandchild->parent = into;
+	}
+
+	into->tree->backend.treeChanged(Hy3TreeChange::Moved, into);
+	into->tree->backend.treeChanged(Hy3TreeChange::Removed, child);
+	into->tree->nodes.remove(*child);
+
+	return true;
+}
+
+Hy3Node* Hy3Node::removeFromParentRecursive() {
+	Hy3Node* parent = this;
+
+	this->tree->log(Hy3LogLevel::Log, "Recursively removing parent nodes of %p", parent);
+	this->tree->backend.markWorkspaceDirty(this->getWorkspace());
+
+	while (parent != nullptr) {
+		if (parent->parent == nullptr) {
+			this->tree->log(Hy3LogLevel::Error, "* UAF DEBUGGING - %p's parent is null, its the root group", parent);
+
+			if (parent == this) {
+				this->tree->log(Hy3LogLevel::Error, "* UAF DEBUGGING - returning nullptr as this == root group");
+			} else {
+				this->tree->log(Hy3LogLevel::Error, "* UAF DEBUGGING - deallocing %p and returning nullptr", parent);
+				this->tree->backend.treeChanged(Hy3TreeChange::Removed, parent);
+				parent->tree->nodes.remove(*parent);
+			}
+			return nullptr;
+		}
+
+		auto* child = parent;
+		parent = parent->parent;
+		auto& group = parent->data.as_group;
+
+		child->mruUnlink();
+
+		if (group.children.size() > 2 && (group.focused_child == child || group.focused_child == nullptr)) {
+			group.group_focused = false;
+
+			// like i3, focus returns to the most recently focused sibling.
+			// neighbors are only used if none of them was ever focused.
+			// floated window placeholders take no space and are skipped.
+			auto* next = mruVisibleChild(group);
+			if (next == nullptr) next = visibleSibling(child, false);
+			if (next == nullptr) next = visibleSibling(child, true);
+
+			// every sibling is collapsed, the group is collapsed with them
+			if (next == nullptr) {
+				auto iter = std::find(group.children.begin(), group.children.end(), child);
+				next = iter == group.children.begin() ? *std::next(iter) : *std::prev(iter);
+			}
+
+			group.focused_child = next;
+		}
+
+		if (!group.children.remove(child)) {
+			this->tree->log(Hy3LogLevel::Critical, "Was unable to remove child node %p from parent %p. Child likely has a false parent pointer.", child, parent);
+			return nullptr;
+		}
+
+		group.group_focused = false;
+		if (group.children.size() == 1) {
+			group.focused_child = group.children.front();
+		}
+
+		auto child_size_ratio = child->size_ratio;
+		if (child != this) {
+			this->tree->backend.treeChanged(Hy3TreeChange::Removed, child);
+			parent->tree->nodes.remove(*child);
+		} else {
+			child->parent = nullptr;
+		}
+
+		if (!group.children.empty()) {
+			auto child_count = group.children.size();
+			if (std::find(group.children.begin(), group.children.end(), this) != group.children.end()) {
+				child_count -= 1;
+			}
+
+			auto splitmod = hy3core::removalRatioShift(child_size_ratio, child_count);
+
+			for (auto* child: group.children) {
+				child->size_ratio += splitmod;
+				this->tree->backend.treeChanged(Hy3TreeChange::RatioChanged, child);
+			}
+
+			break;
+		}
+	}
+
+	if (parent != nullptr) this->tree->queueNormalize(parent);
+
+	return parent;
+}
+
+Hy3Node* Hy3Node::intoGroup(Hy3GroupLayout layout) {
+	this->tree->nodes.push_back({
+		.parent = this,
+		.data = layout,
+		.tree = this->tree,
+	});
+
+	auto* node = &this->tree->nodes.back();
+	swapData(*this, *node);
+
+	this->data = layout;
+	this->data.as_group.children.push_back(node);
+	this->data.as_group.group_focused = false;
+	this->data.as_group.focused_child = node;
+	this->tree->backend.treeChanged(Hy3TreeChange::Created, this);
+	this->tree->backend.treeChanged(Hy3TreeChange::Moved, node);
+	this->recalcSizePosRecursive();
+
+	return node;
+}
+
+bool Hy3GroupData::hasChild(Hy3Node* node) {
+	for (auto child: this->children) {
+		if (child == node) return true;
+
+		if (child->data.type == Hy3NodeData::Group) {
+			if (child->data.as_group.hasChild(node)) return true;
+		}
+	}
+
+	return false;
+}
+
+void Hy3Node::swapData(Hy3Node& a, Hy3Node& b) {
+	Hy3NodeData aData = std::move(a.data);
+	a.data = std::move(b.data);
+	b.data = std::move(aData);
+
+	// ids follow the data, so observers see the contents of a node move rather than change
+	std::swap(a.id, b.id);
+
+	if (a.data.type == Hy3NodeData::Group) {
+		for (auto child: a.data.as_group.children) {
+			child->parent = &a;
+		}
+	}
+
+	if (b.data.type == Hy3NodeData::Group) {
+		for (auto child: b.data.as_group.children) {
+			child->parent = &b;
+		}
+	}
+}
+
+int Hy3Tree::getWorkspaceNodeCount(const int& id) {
+	int count = 0;
+
+	for (auto& node: this->nodes) {
+		if (node.valid && !node.placeholder && node.getWorkspace() == id) count++;
+	}
+
+	return count;
+}
+
+Hy3Node* Hy3Tree::getNodeFromWindow(Hy3WindowHandle window) {
+	for (auto& node: this->nodes) {
+		if (node.data.type == Hy3NodeData::Window && node.data.as_window == window && node.valid && !node.placeholder) {
+			return &node;
+		}
+	}
+
+	return nullptr;
+}
+
+Hy3Node* Hy3Tree::getPlaceholderFromWindow(Hy3WindowHandle window) {
+	for (auto& node: this->nodes) {
+		if (node.data.type == Hy3NodeData::Window && node.data.as_window == window && node.valid && node.placeholder) {
+			return &node;
+		}
+	}
+
+	return nullptr;
+}
+
+Hy3Node* Hy3Tree::getNodeById(uint64_t id) {
+	for (auto& node: this->nodes) {
+		if (node.id == id) return &node;
+	}
+
+	return nullptr;
+}
+
+Hy3Node* Hy3Tree::getWorkspaceRootGroup(const int& id) {
+	for (auto& node: this->nodes) {
+		if (node.workspace_id == id && node.parent == nullptr && node.data.type == Hy3NodeData::Group) {
+			return &node;
+		}
+	}
+
+	return nullptr;
+}
+
+Hy3Node* Hy3Tree::getWorkspaceFocusedNode(const int& id) {
+	auto* rootNode = this->getWorkspaceRootGroup(id);
+	if (rootNode == nullptr) return nullptr;
+
+	// only left on a placeholder if every window of the workspace floats
+	auto* focused = rootNode->getFocusedNode();
+	return focused->isCollapsed() ? nullptr : focused;
+}
+
+void Hy3Tree::queueNormalize(Hy3Node* node) {
+	node->normalize_pending = true;
+	this->normalize_queued = true;
+}
+
+static bool isSplitLayout(Hy3GroupLayout layout) {
+	return layout == Hy3GroupLayout::SplitH || layout == Hy3GroupLayout::SplitV;
+}
+
+// Splice the children of a group into its parent, which has the same split layout.
+// Ratios are scaled so every node keeps its size.
+static void mergeIntoParent(Hy3Node* node) {
+	auto* parent = node->parent;
+	auto& parent_group = parent->data.as_group;
+	auto& group = node->data.as_group;
+
+	parent->tree->log(Hy3LogLevel::Log, "Merging %p into same orientation parent %p", node, parent);
+
+	// the children take the group's place in the parent's focus history, keeping their order
+	if (group.mru_head != nullptr && node->mruLinked()) {
+		auto* last = group.mru_head;
+		while (last->mru_next != nullptr) last = last->mru_next;
+
+		group.mru_head->mru_prev = node->mru_prev;
+		last->mru_next = node->mru_next;
+		if (node->mru_prev != nullptr) node->mru_prev->mru_next = group.mru_head;
+		else parent_group.mru_head = group.mru_head;
+		if (node->mru_next != nullptr) node->mru_next->mru_prev = last;
+
+		node->mru_prev = nullptr;
+		node->mru_next = nullptr;
+	} else {
+		node->mruUnlink();
+
+		for (auto* child: group.children) {
+			child->mru_prev = nullptr;
+			child->mru_next = nullptr;
+		}
+	}
+
+	group.mru_head = nullptr;
+
+	double sibling_scale;
+	double child_scale;
+	hy3core::mergeRatioScales(parent_group.children.size(), group.children.size(), node->size_ratio, sibling_scale, child_scale);
+
+	for (auto* sibling: parent_group.children) {
+		if (sibling == node) continue;
+		sibling->size_ratio *= sibling_scale;
+		parent->tree->backend.treeChanged(Hy3TreeChange::RatioChanged, sibling);
+	}
+
+	for (auto* child: group.children) {
+		child->parent = parent;
+		child->size_ratio *= child_scale;
+		parent->tree->backend.treeChanged(Hy3TreeChange::Moved, child);
+		parent->tree->backend.treeChanged(Hy3TreeChange::RatioChanged, child);
+	}
+
+	// the parent's selection is left alone. a selected group hands its selection to
+	// its focused child instead of widening it to the parent.
+	if (parent_group.focused_child == node) {
+		parent_group.focused_child = group.focused_child != nullptr ? group.focused_child : group.children.front();
+	}
+
+	auto iter = std::find(parent_group.children.begin(), parent_group.children.end(), node);
+	parent_group.children.splice(iter, group.children);
+	parent_group.children.erase(iter);
+
+	parent->tree->backend.treeChanged(Hy3TreeChange::Removed, node);
+	parent->tree->nodes.remove(*node);
+}
+
+void Hy3Tree::normalizeTrees() {
+	trace::Span span("normalizeTrees");
+	this->normalize_queued = false;
+
+	std::vector<Hy3Node*> queue;
+	for (auto& node: this->nodes) {
+		if (node.normalize_pending) queue.push_back(&node);
+	}
+
+	// queued nodes removed while normalizing an earlier one are already covered by it
+	auto dequeue = [&](Hy3Node* node) {
+		if (!node->normalize_pending) return;
+		auto iter = std::find(queue.begin(), queue.end(), node);
+		if (iter != queue.end()) *iter = nullptr;
+	};
+
+	std::unordered_set<int> relayout;
+
+	for (auto* node: queue) {
+		if (node == nullptr) continue;
+		node->normalize_pending = false;
+		if (node->data.type != Hy3NodeData::Group) continue;
+
+		auto workspace = node->getWorkspace();
+		auto changed = false;
+
+		while (node->data.as_group.children.size() == 1
+				&& node->data.as_group.children.front()->data.type == Hy3NodeData::Group)
+		{
+			dequeue(node->data.as_group.children.front());
+			Hy3Node::swallowGroups(node);
+			changed = true;
+		}
+
+		if (node->parent != nullptr
+				&& isSplitLayout(node->data.as_group.layout)
+				&& node->parent->data.as_group.layout == node->data.as_group.layout)
+		{
+			dequeue(node);
+			mergeIntoParent(node);
+			changed = true;
+		}
+
+		if (changed) relayout.insert(workspace);
+	}
+
+	// once per workspace, unchanged windows are not reconfigured
+	for (auto workspace: relayout) {
+		auto* root = this->getWorkspaceRootGroup(workspace);
+		if (root != nullptr) root->recalcSizePosRecursive();
+	}
+}
+
+void Hy3Tree::makeGroupOn(Hy3Node* node, Hy3GroupLayout layout) {
+	if (node == nullptr) return;
+
+	if (node->parent != nullptr) {
+		auto& group = node->parent->data.as_group;
+		if (group.children.size() == 1
+			&& (group.layout == Hy3GroupLayout::SplitH
+			|| group.layout == Hy3GroupLayout::SplitV))
+		{
+			group.layout = layout;
+			this->backend.treeChanged(Hy3TreeChange::LayoutChanged, node->parent);
+			node->parent->recalcSizePosRecursive();
+			return;
+		}
+	}
+
+	node->intoGroup(layout);
+}
+
+void Hy3Tree::makeOppositeGroupOn(Hy3Node* node) {
+	if (node == nullptr) return;
+
+	if (node->parent == nullptr) {
+		node->intoGroup(Hy3GroupLayout::SplitH);
+	} else {
+		auto& group = node->parent->data.as_group;
+		auto layout = group.layout == Hy3GroupLayout::SplitH
+			? Hy3GroupLayout::SplitV
+			: Hy3GroupLayout::SplitH;
+
+		if (group.children.size() == 1) {
+			group.layout = layout;
+			this->backend.treeChanged(Hy3TreeChange::LayoutChanged, node->parent);
+			node->parent->recalcSizePosRecursive();
+		} else {
+			node->intoGroup(layout);
+		}
+	}
+}
+
+Hy3Node* Hy3Tree::shiftOrGetFocus(Hy3Node& node, ShiftDirection direction, bool shift, bool once) {
+	trace::Span span("shiftOrGetFocus");
+	auto* break_origin = &node;
+	auto* break_parent = break_origin->parent;
+
+	auto has_broken_once = false;
+
+	// break parents until we hit a container oriented the same way as the shift direction
+	while (true) {
+		if (break_parent == nullptr) return nullptr;
+
+		auto& group = break_parent->data.as_group; // must be a group in order to be a parent
+
+		if (shiftMatchesLayout(group.layout, direction)) {
+			// group has the correct orientation
+
+			if (once && shift && has_broken_once) break;
+			if (break_origin != &node) has_broken_once = true;
+
+			// if this movement would break out of the group, continue the break loop (do not enter this if)
+			// otherwise break.
+			if ((has_broken_once && once && shift)
+					|| !((!shiftIsForward(direction) && edgeChild(group, false) == break_origin)
+							 || (shiftIsForward(direction) && edgeChild(group, true) == break_origin)))
+				break;
+		}
+
+		if (break_parent->parent == nullptr) {
+			if (!shift) return nullptr;
+
+			// if we haven't gone up any levels and the group is in the same direction
+			// there's no reason to wrap the root group.
+			if (shiftMatchesLayout(group.layout, direction)) break;
+
+			if (group.layout != Hy3GroupLayout::Tabbed
+				&& group.children.size() == 2
+				&& std::find(group.children.begin(), group.children.end(), &node) != group.children.end()
+			) {
+				group.layout = shiftIsVertical(direction) ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
+				this->backend.treeChanged(Hy3TreeChange::LayoutChanged, break_parent);
+				// child groups may now share the root's orientation
+				this->queueNormalize(break_parent);
+			} else {
+				// wrap the root group in another group
+				this->nodes.push_back({
+						.parent = break_parent,
+						.data = shiftIsVertical(direction) ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH,
+						.position = break_parent->position,
+						.size = break_parent->size,
+						.tree = this,
+				});
+
+				auto* newChild = &this->nodes.back();
+				Hy3Node::swapData(*break_parent, *newChild);
+				break_parent->data.as_group.children.push_back(newChild);
+				break_parent->data.as_group.group_focused = false;
+				break_parent->data.as_group.focused_child = newChild;
+				this->backend.treeChanged(Hy3TreeChange::Created, break_parent);
+				this->backend.treeChanged(Hy3TreeChange::Moved, newChild);
+				this->queueNormalize(break_parent);
+				this->queueNormalize(newChild);
+				break_origin = newChild;
+			}
+
+			break;
+		} else {
+			break_origin = break_parent;
+			break_parent = break_origin->parent;
+		}
+	}
+
+	auto& parent_group = break_parent->data.as_group;
+	Hy3Node* target_group = break_parent;
+	std::list<Hy3Node*>::iterator insert;
+
+	if (break_origin == edgeChild(parent_group, false) && !shiftIsForward(direction)) {
+		if (!shift) return nullptr;
+		insert = parent_group.children.begin();
+	} else if (break_origin == edgeChild(parent_group, true) && shiftIsForward(direction)) {
+		if (!shift) return nullptr;
+		insert = parent_group.children.end();
+	} else {
+		auto& group_data = target_group->data.as_group;
+
+		auto iter = std::find(group_data.children.begin(), group_data.children.end(), break_origin);
+
+		// placeholders are passed over, there is a node taking space before the edge
+		do {
+			if (shiftIsForward(direction)) iter = std::next(iter);
+			else iter = std::prev(iter);
+		} while ((*iter)->isCollapsed());
+
+		if ((*iter)->data.type == Hy3NodeData::Window || (shift && once && has_broken_once)) {
+			if (shift) {
+				if (target_group == node.parent) {
+					if (shiftIsForward(direction)) insert = std::next(iter);
+					else insert = iter;
+				} else {
+					if (shiftIsForward(direction)) insert = iter;
+					else insert = std::next(iter);
+				}
+			} else return *iter;
+		} else {
+			// break into neighboring groups until we hit a window
+			while (true) {
+				target_group = *iter;
+				auto& group_data = target_group->data.as_group;
+
+				if (group_data.children.empty()) return nullptr; // in theory this would never happen
+
+				bool shift_after = false;
+
+				if (shiftMatchesLayout(group_data.layout, direction)) {
+					// if the group has the same orientation as movement pick the last/first child based
+					// on movement direction
+					if (shiftIsForward(direction)) {
+						iter = std::find(group_data.children.begin(), group_data.children.end(), edgeChild(group_data, false));
+					} else {
+						iter = std::find(group_data.children.begin(), group_data.children.end(), edgeChild(group_data, true));
+						shift_after = true;
+					}
+				} else {
+					if (group_data.focused_child != nullptr) {
+						iter = std::find(group_data.children.begin(), group_data.children.end(), group_data.focused_child);
+						shift_after = true;
+					} else {
+						iter = std::find(group_data.children.begin(), group_data.children.end(), edgeChild(group_data, false));
+					}
+				}
+
+				if (shift && once) {
+					if (shift_after) insert = std::next(iter);
+					else insert = iter;
+					break;
+				}
+
+				if ((*iter)->data.type == Hy3NodeData::Window) {
+					if (shift) {
+						if (shift_after) insert = std::next(iter);
+						else insert = iter;
+						break;
+					} else {
+						return *iter;
+					}
+				}
+			}
+		}
+	}
+
+	auto& group_data = target_group->data.as_group;
+
+	if (target_group == node.parent) {
+		// nullptr is used as a signal value instead of removing it first to avoid iterator invalidation.
+		auto iter = std::find(group_data.children.begin(), group_data.children.end(), &node);
+		*iter = nullptr;
+		target_group->data.as_group.children.insert(insert, &node);
+		target_group->data.as_group.children.remove(nullptr);
+		this->backend.treeChanged(Hy3TreeChange::Moved, &node);
+		target_group->recalcSizePosRecursive();
+	} else {
+		target_group->data.as_group.children.insert(insert, &node);
+
+		// must happen AFTER `insert` is used
+		auto* old_parent = node.removeFromParentRecursive();
+		node.parent = target_group;
+		node.size_ratio = 1.0;
+		this->backend.treeChanged(Hy3TreeChange::Moved, &node);
+		this->backend.treeChanged(Hy3TreeChange::RatioChanged, &node);
+
+		if (old_parent != nullptr) old_parent->recalcSizePosRecursive();
+		target_group->recalcSizePosRecursive();
+
+		// groups around the target may have been left redundant by the move
+		this->queueNormalize(target_group);
+		if (target_group->parent != nullptr) this->queueNormalize(target_group->parent);
+
+		node.markFocused();
+	}
+
+	return nullptr;
+}
+
+std::string Hy3Node::debugNode() {
+	std::stringstream buf;
+	std::string addr = "0x" + std::to_string((size_t)this);
+	switch (this->data.type) {
+	case Hy3NodeData::Window:
+		buf << "window(";
+		buf << std::hex << this;
+		buf << ") [hypr ";
+		buf << this->data.as_window;
+		buf << "] size ratio: ";
+		buf << this->size_ratio;
+		break;
+	case Hy3NodeData::Group:
+		buf << "group(";
+		buf << std::hex << this;
+		buf << ") [";
+
+		switch (this->data.as_group.layout) {
+		case Hy3GroupLayout::SplitH:
+			buf << "splith";
+			break;
+		case Hy3GroupLayout::SplitV:
+			buf << "splitv";
+			break;
+		case Hy3GroupLayout::Tabbed:
+			buf << "tabs";
+			break;
+		case Hy3GroupLayout::Accordion:
+			buf << "accordion";
+			break;
+		}
+
+		buf << "] size ratio: ";
+		buf << this->size_ratio;
+		for (auto* child: this->data.as_group.children) {
+			buf << "\n|-";
+			if (child == nullptr) {
+				buf << "nullptr";
+			} else {
+				// this is terrible
+				for (char c: child->debugNode()) {
+					buf << c;
+					if (c == '\n') buf << "  ";
+				}
+			}
+		}
+
+		break;
+	}
+
+	return buf.str();
+}
+
+Hy3Tree::Hy3Tree(Hy3TreeBackend& backend): backend(backend) {}
+
+Hy3Node* Hy3Tree::insertWindow(Hy3WindowHandle window, int workspace, Hy3Node* after, const hy3core::Vec2& root_position, const hy3core::Vec2& root_size) {
+	Hy3Node* opening_into;
+
+	if (after != nullptr) {
+		opening_into = after->parent;
+	} else if ((opening_into = this->getWorkspaceRootGroup(workspace)) == nullptr) {
+		this->nodes.push_back({
+			.data = Hy3GroupLayout::SplitH,
+			.position = root_position,
+			.size = root_size,
+			.workspace_id = workspace,
+			.tree = this,
+		});
+
+		opening_into = &this->nodes.back();
+		this->backend.treeChanged(Hy3TreeChange::Created, opening_into);
+	}
+
+	if (opening_into->data.type != Hy3NodeData::Group) {
+		this->log(Hy3LogLevel::Critical, "opening_into node %p was not of type Group", opening_into);
+		return nullptr;
+	}
+
+	if (opening_into->getWorkspace() != workspace) {
+		this->log(Hy3LogLevel::Error, "opening_into node %p has workspace %d which does not match the opening window (workspace %d)", opening_into, opening_into->getWorkspace(), workspace);
+	}
+
+	this->nodes.push_back({
+		.parent = opening_into,
+		.data = window,
+		.tree = this,
+	});
+
+	auto& node = this->nodes.back();
+
+	if (after == nullptr) {
+		opening_into->data.as_group.children.push_back(&node);
+	} else {
+		auto& children = opening_into->data.as_group.children;
+		auto iter = std::find(children.begin(), children.end(), after);
+		children.insert(std::next(iter), &node);
+	}
+
+	this->backend.treeChanged(Hy3TreeChange::Created, &node);
+	this->log(Hy3LogLevel::Log, "opened new window %p(node: %p) on window %p in %p", window, &node, after, opening_into);
+
+	node.markFocused();
+	opening_into->recalcSizePosRecursive();
+
+	return &node;
+}
+
+void Hy3Tree::deleteNode(Hy3Node* node) {
+	auto* parent = node->removeFromParentRecursive();
+	this->backend.treeChanged(Hy3TreeChange::Removed, node);
+	this->nodes.remove(*node);
+
+	if (parent != nullptr) parent->recalcSizePosRecursive();
+}
+
+void Hy3Tree::log(Hy3LogLevel level, const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	va_list size_args;
+	va_copy(size_args, args);
+	auto length = vsnprintf(nullptr, 0, fmt, size_args);
+	va_end(size_args);
+
+	std::string message(length < 0 ? 0 : length, '\0');
+	vsnprintf(message.data(), message.size() + 1, fmt, args);
+	va_end(args);
+
+	this->backend.log(level, message);
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+#include "Types.hpp"
+
+class Hy3Tree;
+struct Hy3Node;
+
+// Opaque reference to a compositor window. The tree only compares handles,
+// what they point to is up to the backend.
+struct Hy3Window;
+using Hy3WindowHandle = Hy3Window*;
+
+enum class Hy3TreeChange {
+	Created,
+	Removed,
+	Moved,
+	LayoutChanged,
+	RatioChanged,
+	FocusChanged,
+};
+
+enum class Hy3LogLevel {
+	Log,
+	Error,
+	// an error the user should be told about
+	Critical,
+};
+
+struct Hy3TreeSettings {
+	int gaps_in = 0;
+	int gaps_out = 0;
+	int accordion_collapsed_size = 60;
+};
+
+// Everything the tree needs from the compositor. The plugin implements it with
+// hyprland, the benchmark with a headless fake.
+class Hy3TreeBackend {
+public:
+	virtual ~Hy3TreeBackend() = default;
+
+	// nestable scope around a relayout, see Hy3TreePass
+	virtual void beginPass() = 0;
+	virtual void endPass() = 0;
+
+	// give a window node's tile to its window
+	virtual void applyNodeDataToWindow(Hy3Node*, bool force) = 0;
+	// focus a window, or no window if null
+	virtual void focusWindow(Hy3WindowHandle) = 0;
+	virtual void raiseWindow(Hy3WindowHandle) = 0;
+	// the tiles or visible windows of a workspace changed
+	virtual void markWorkspaceDirty(int workspace) = 0;
+	virtual void treeChanged(Hy3TreeChange, Hy3Node*) = 0;
+	virtual Hy3TreeSettings getTreeSettings() = 0;
+	virtual void log(Hy3LogLevel, const std::string&) = 0;
+};
+
+// Nestable scope around a relayout. Work that only needs to happen once
+// per relayout is deferred until the outermost pass ends.
+struct Hy3TreePass {
+	Hy3Tree* tree;
+
+	Hy3TreePass(Hy3Tree*);
+	~Hy3TreePass();
+
+	Hy3TreePass(const Hy3TreePass&) = delete;
+	Hy3TreePass& operator=(const Hy3TreePass&) = delete;
+};
+
+struct Hy3GroupData {
+	Hy3GroupLayout layout = Hy3GroupLayout::SplitH;
+	std::list<Hy3Node*> children;
+	bool group_focused = true;
+	Hy3Node* focused_child = nullptr;
+	// most recently focused child, the others follow through Hy3Node::mru_next.
+	// children that were never focused are not linked.
+	Hy3Node* mru_head = nullptr;
+
+	bool hasChild(Hy3Node* child);
+
+	Hy3GroupData(Hy3GroupLayout layout);
+
+private:
+	Hy3GroupData(Hy3GroupData&&) = default;
+	Hy3GroupData(const Hy3GroupData&) = default;
+
+	friend class Hy3NodeData;
+};
+
+class Hy3NodeData {
+public:
+	enum { Group, Window } type;
+	union {
+		Hy3GroupData as_group;
+		Hy3WindowHandle as_window;
+	};
+
+	// tag of the template node this was placed as, 0 if none. follows the data
+	// through swaps and swallows, so it stays valid as the tree is normalized.
+	uint64_t template_tag = 0;
+
+	bool operator==(const Hy3NodeData&) const;
+
+	Hy3NodeData();
+	~Hy3NodeData();
+	Hy3NodeData(Hy3WindowHandle);
+	Hy3NodeData(Hy3GroupLayout);
+	Hy3NodeData& operator=(Hy3WindowHandle);
+	Hy3NodeData& operator=(Hy3GroupLayout);
+
+	//private: - I give up, C++ wins
+	Hy3NodeData(Hy3GroupData);
+	Hy3NodeData(const Hy3NodeData&);
+	Hy3NodeData(Hy3NodeData&&);
+	Hy3NodeData& operator=(const Hy3NodeData&);
+	Hy3NodeData& operator=(Hy3NodeData&&);
+};
+
+struct Hy3Node {
+	Hy3Node* parent = nullptr;
+	Hy3NodeData data;
+	hy3core::Vec2 position;
+	hy3core::Vec2 size;
+	float size_ratio = 1.0;
+	// only meaningful for root nodes, use getWorkspace()
+	int workspace_id = -1;
+	// cleared when the window of a window node closes. invalid nodes are
+	// removed by the backend when its next layout pass begins.
+	bool valid = true;
+	// set when the node's geometry changed while its workspace was hidden
+	bool geometry_pending = false;
+	// geometry of a window node when its workspace was last marked dirty for it
+	hy3core::Vec2 indexed_position;
+	hy3core::Vec2 indexed_size;
+	// set on groups that lost children, normalized at the end of the pass
+	bool normalize_pending = false;
+	// set on the node of a tiled window while it floats. the node keeps the
+	// window's place in the tree but takes no space until it is tiled again.
+	bool placeholder = false;
+	// neighbors in the parent group's most recently focused list
+	Hy3Node* mru_prev = nullptr;
+	Hy3Node* mru_next = nullptr;
+	Hy3Tree* tree = nullptr;
+	// stable identifier exposed through the tree snapshot and tree events
+	uint64_t id = ++Hy3Node::last_id;
+
+	inline static uint64_t last_id = 0;
+
+	void recalcSizePosRecursive(bool force = false);
+	// get the workspace of the tree this node is part of
+	int getWorkspace();
+	std::string debugNode();
+	void markFocused();
+	void focus();
+	void raiseToTop();
+	Hy3Node* getFocusedNode();
+	// move this node to the front of its parent's most recently focused list
+	void mruTouch();
+	void mruUnlink();
+	bool mruLinked();
+	// true for placeholders and groups containing only placeholders
+	bool isCollapsed();
+
+	bool operator==(const Hy3Node&) const;
+
+	// Attempt to swallow a group. returns true if swallowed
+	static bool swallowGroups(Hy3Node*);
+	// Remove this node from its parent, deleting the parent if it was
+	// the only child and recursing if the parent was the only child of it's parent.
+	// The remaining parent is queued for normalization.
+	Hy3Node* removeFromParentRecursive();
+
+	// Replace this node with a group, returning this node's new address.
+	Hy3Node* intoGroup(Hy3GroupLayout);
+
+	static void swapData(Hy3Node&, Hy3Node&);
+};
+
+// first or last child of a group that takes space, null if there is none
+Hy3Node* edgeChild(Hy3GroupData& group, bool last);
+// number of children of a group that take space
+size_t visibleChildCount(Hy3GroupData& group);
+// closest sibling after (or before) a node that takes space, null if there is none
+Hy3Node* visibleSibling(Hy3Node* node, bool forward);
+// most recently focused child of a group that still takes space, null if none was focused
+Hy3Node* mruVisibleChild(Hy3GroupData& group);
+
+// The node trees of every workspace and the operations on them.
+// Nothing here talks to the compositor except through the backend.
+class Hy3Tree {
+public:
+	Hy3Tree(Hy3TreeBackend&);
+
+	Hy3TreeBackend& backend;
+	std::list<Hy3Node> nodes;
+	// set when any node has normalize_pending set
+	bool normalize_queued = false;
+
+	Hy3Node* getWorkspaceRootGroup(const int&);
+	Hy3Node* getWorkspaceFocusedNode(const int&);
+	int getWorkspaceNodeCount(const int&);
+	Hy3Node* getNodeFromWindow(Hy3WindowHandle);
+	Hy3Node* getPlaceholderFromWindow(Hy3WindowHandle);
+	Hy3Node* getNodeById(uint64_t);
+
+	// Insert a window after `after`, or at the end of the workspace's root group if
+	// it is null. The root group is created with the given area if there is none.
+	// The new node is focused and its group relaid out.
+	Hy3Node* insertWindow(Hy3WindowHandle, int workspace, Hy3Node* after, const hy3core::Vec2& root_position, const hy3core::Vec2& root_size);
+	// remove a window node and relayout what is left of its parent
+	void deleteNode(Hy3Node*);
+
+	void makeGroupOn(Hy3Node*, Hy3GroupLayout);
+	void makeOppositeGroupOn(Hy3Node*);
+
+	// if shift is true, shift the window in the given direction, returning nullptr,
+	// if shift is false, return the window in the given direction or nullptr.
+	// if once is true, only one group will be broken out of / into
+	Hy3Node* shiftOrGetFocus(Hy3Node&, ShiftDirection, bool, bool);
+
+	void queueNormalize(Hy3Node*);
+	// collapse single child group chains and merge same orientation nesting
+	// below every node queued for normalization, then relayout what changed.
+	void normalizeTrees();
+
+	// printf style message passed on to the backend
+	void log(Hy3LogLevel, const char* fmt, ...);
+};
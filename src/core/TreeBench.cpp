@@ -0,0 +1,184 @@
+// Stress test and benchmark of the node tree against a headless backend.
+// Opens windows across a few workspaces, then runs random moves, focus changes,
+// group changes and window churn, checking the tree after every operation.
+// Timings and counters are printed in the same format as `hy3:stats`.
+//
+//   hy3core-bench [windows] [operations] [seed]
+
+#include "Stats.hpp"
+#include "Tree.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+class BenchBackend: public Hy3TreeBackend {
+public:
+	Hy3Tree* tree = nullptr;
+	int pass_depth = 0;
+
+	void beginPass() override {
+		this->pass_depth++;
+	}
+
+	void endPass() override {
+		if (this->pass_depth == 1 && this->tree->normalize_queued) this->tree->normalizeTrees();
+		if (--this->pass_depth == 0) stats::count(stats::Counter::LayoutPasses);
+	}
+
+	void applyNodeDataToWindow(Hy3Node*, bool force) override {
+		stats::count(stats::Counter::ConfiguresSent);
+	}
+
+	void focusWindow(Hy3WindowHandle) override {}
+	void raiseWindow(Hy3WindowHandle) override {}
+	void markWorkspaceDirty(int) override {}
+
+	void treeChanged(Hy3TreeChange, Hy3Node*) override {
+		stats::count(stats::Counter::TreeMutations);
+	}
+
+	Hy3TreeSettings getTreeSettings() override {
+		return Hy3TreeSettings {
+			.gaps_in = 5,
+			.gaps_out = 20,
+		};
+	}
+
+	void log(Hy3LogLevel level, const std::string& message) override {
+		if (level == Hy3LogLevel::Critical) fprintf(stderr, "%s\n", message.c_str());
+	}
+};
+
+static const hy3core::Vec2 ROOT_POSITION = {0, 0};
+static const hy3core::Vec2 ROOT_SIZE = {2560, 1440};
+static constexpr int WORKSPACES = 4;
+
+// every child points back at its parent and every window is counted once
+static bool checkNode(Hy3Node* node, size_t& windows) {
+	if (node->data.type == Hy3NodeData::Window) {
+		if (!node->placeholder) windows++;
+		return true;
+	}
+
+	auto& group = node->data.as_group;
+	if (group.children.empty()) return false;
+
+	for (auto* child: group.children) {
+		if (child->parent != node || child->tree != node->tree) return false;
+		if (!checkNode(child, windows)) return false;
+	}
+
+	return true;
+}
+
+static bool checkTree(Hy3Tree& tree, size_t expected_windows) {
+	size_t windows = 0;
+
+	for (int workspace = 0; workspace < WORKSPACES; workspace++) {
+		auto* root = tree.getWorkspaceRootGroup(workspace);
+		if (root != nullptr && !checkNode(root, windows)) return false;
+	}
+
+	return windows == expected_windows;
+}
+
+int main(int argc, char** argv) {
+	auto window_count = argc > 1 ? atoi(argv[1]) : 200;
+	auto operation_count = argc > 2 ? atoi(argv[2]) : 100000;
+	auto seed = argc > 3 ? (unsigned) atoi(argv[3]) : 1u;
+
+	BenchBackend backend;
+	Hy3Tree tree(backend);
+	backend.tree = &tree;
+
+	std::mt19937 rng(seed);
+	auto random = [&](int n) { return (int) std::uniform_int_distribution<int>(0, n - 1)(rng); };
+
+	// fake handles, the tree never dereferences them
+	uintptr_t next_window = 1;
+	std::vector<Hy3WindowHandle> windows;
+
+	auto open = [&](int workspace) {
+		stats::Timer timer(stats::Timing::OnWindowCreatedTiling);
+		Hy3TreePass pass(&tree);
+		auto* window = (Hy3WindowHandle) next_window++;
+		auto* after = tree.getWorkspaceFocusedNode(workspace);
+		if (after != nullptr && after->data.type != Hy3NodeData::Window) after = nullptr;
+
+		if (tree.insertWindow(window, workspace, after, ROOT_POSITION, ROOT_SIZE) != nullptr) {
+			windows.push_back(window);
+		}
+	};
+
+	for (int i = 0; i < window_count; i++) {
+		open(i % WORKSPACES);
+	}
+
+	if (!checkTree(tree, windows.size())) {
+		fprintf(stderr, "tree is inconsistent after opening %d windows\n", window_count);
+		return 1;
+	}
+
+	stats::reset();
+
+	for (int i = 0; i < operation_count; i++) {
+		auto workspace = random(WORKSPACES);
+		auto* focused = tree.getWorkspaceFocusedNode(workspace);
+		auto direction = (ShiftDirection) random(4);
+
+		switch (random(5)) {
+		case 0:
+			if (focused == nullptr) break;
+			{
+				stats::Timer timer(stats::Timing::DispatchMoveWindow);
+				Hy3TreePass pass(&tree);
+				tree.shiftOrGetFocus(*focused, direction, true, random(2));
+			}
+			break;
+		case 1:
+			if (focused == nullptr) break;
+			{
+				stats::Timer timer(stats::Timing::DispatchMoveFocus);
+				Hy3TreePass pass(&tree);
+				auto* target = tree.shiftOrGetFocus(*focused, direction, false, false);
+				if (target != nullptr) target->focus();
+			}
+			break;
+		case 2:
+			if (focused == nullptr) break;
+			{
+				stats::Timer timer(stats::Timing::DispatchMakeGroup);
+				Hy3TreePass pass(&tree);
+				tree.makeGroupOn(focused, (Hy3GroupLayout) random(4));
+			}
+			break;
+		case 3: {
+			if (windows.empty()) break;
+			auto index = random(windows.size());
+			auto* node = tree.getNodeFromWindow(windows[index]);
+			windows[index] = windows.back();
+			windows.pop_back();
+
+			stats::Timer timer(stats::Timing::OnWindowRemovedTiling);
+			Hy3TreePass pass(&tree);
+			tree.deleteNode(node);
+		} break;
+		case 4:
+			open(workspace);
+			break;
+		}
+
+		if (!checkTree(tree, windows.size())) {
+			fprintf(stderr, "tree is inconsistent after operation %d (seed %u)\n", i, seed);
+			return 1;
+		}
+	}
+
+	stats::setNodeCount(tree.nodes.size());
+	printf("%d operations on %d windows, seed %u\n%s", operation_count, window_count, seed, stats::dump().c_str());
+
+	return 0;
+}
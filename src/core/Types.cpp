@@ -0,0 +1,28 @@
+#include "Types.hpp"
+
+bool shiftIsForward(ShiftDirection direction) {
+	return direction == ShiftDirection::Right || direction == ShiftDirection::Down;
+}
+
+bool shiftIsVertical(ShiftDirection direction) {
+	return direction == ShiftDirection::Up || direction == ShiftDirection::Down;
+}
+
+bool layoutIsVertical(Hy3GroupLayout layout) {
+	return layout == Hy3GroupLayout::SplitV || layout == Hy3GroupLayout::Accordion;
+}
+
+bool shiftMatchesLayout(Hy3GroupLayout layout, ShiftDirection direction) {
+	return layoutIsVertical(layout) == shiftIsVertical(direction);
+}
+
+ShiftDirection oppositeShift(ShiftDirection direction) {
+	switch (direction) {
+	case ShiftDirection::Left: return ShiftDirection::Right;
+	case ShiftDirection::Up: return ShiftDirection::Down;
+	case ShiftDirection::Down: return ShiftDirection::Up;
+	case ShiftDirection::Right: return ShiftDirection::Left;
+	}
+
+	return direction;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <concepts>
+
+// Vocabulary shared by the tree engine in core/ and the plugin.
+// Nothing in core/ may include hyprland headers.
+
+enum class Hy3GroupLayout {
+	SplitH,
+	SplitV,
+	Tabbed,
+	// vertical stack where every child except the focused one is collapsed
+	Accordion,
+};
+
+enum class ShiftDirection {
+	Left,
+	Up,
+	Down,
+	Right,
+};
+
+bool shiftIsForward(ShiftDirection);
+bool shiftIsVertical(ShiftDirection);
+bool layoutIsVertical(Hy3GroupLayout);
+bool shiftMatchesLayout(Hy3GroupLayout, ShiftDirection);
+ShiftDirection oppositeShift(ShiftDirection);
+
+namespace hy3core {
+	// Position or size of a node. Converts to and from any vector type with x and y
+	// members, so a backend can mix it with its own vectors.
+	struct Vec2 {
+		double x = 0;
+		double y = 0;
+
+		Vec2() = default;
+		Vec2(double x, double y): x(x), y(y) {}
+
+		template <typename T>
+		requires (!std::same_as<T, Vec2>) && requires (const T& v) { { v.x } -> std::convertible_to<double>; { v.y } -> std::convertible_to<double>; }
+		Vec2(const T& v): x(v.x), y(v.y) {}
+
+		template <typename T>
+		requires (!std::same_as<T, Vec2>) && std::constructible_from<T, double, double>
+		operator T() const {
+			return T(this->x, this->y);
+		}
+
+		Vec2 operator+(const Vec2& rhs) const { return Vec2(this->x + rhs.x, this->y + rhs.y); }
+		Vec2 operator-(const Vec2& rhs) const { return Vec2(this->x - rhs.x, this->y - rhs.y); }
+		Vec2 operator*(double scale) const { return Vec2(this->x * scale, this->y * scale); }
+		Vec2 operator/(double scale) const { return Vec2(this->x / scale, this->y / scale); }
+		bool operator==(const Vec2&) const = default;
+	};
+}
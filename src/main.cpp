@@ -1,10 +1,16 @@
+#include <algorithm>
+#include <climits>
 #include <optional>
+#include <sstream>
+#include <unistd.h>
 
 #include <hyprland/src/plugins/PluginAPI.hpp>
 #include <hyprland/src/Compositor.hpp>
 
 #include "globals.hpp"
-#include "SelectionHook.hpp"
+#include "TreeSnapshot.hpp"
+#include "core/Stats.hpp"
+#include "core/Trace.hpp"
 
 APICALL EXPORT std::string PLUGIN_API_VERSION() {
 	return HYPRLAND_API_VERSION;
@@ -38,6 +44,7 @@ int workspace_for_action() {
 }
 
 void dispatch_makegroup(std::string arg) {
+	stats::Timer timer(stats::Timing::DispatchMakeGroup);
 	int workspace = workspace_for_action();
 	if (workspace < 0) return;
 
@@ -45,6 +52,8 @@ void dispatch_makegroup(std::string arg) {
 		g_Hy3Layout->makeGroupOnWorkspace(workspace, Hy3GroupLayout::SplitH);
 	} else if (arg == "v") {
 		g_Hy3Layout->makeGroupOnWorkspace(workspace, Hy3GroupLayout::SplitV);
+	} else if (arg == "accordion") {
+		g_Hy3Layout->makeGroupOnWorkspace(workspace, Hy3GroupLayout::Accordion);
 	} else if (arg == "opposite") {
 		g_Hy3Layout->makeOppositeGroupOnWorkspace(workspace);
 	}
@@ -59,6 +68,7 @@ std::optional<ShiftDirection> parseShiftArg(std::string arg) {
 }
 
 void dispatch_movewindow(std::string value) {
+	stats::Timer timer(stats::Timing::DispatchMoveWindow);
 	int workspace = workspace_for_action();
 	if (workspace < 0) return;
 
@@ -71,6 +81,7 @@ void dispatch_movewindow(std::string value) {
 }
 
 void dispatch_movefocus(std::string arg) {
+	stats::Timer timer(stats::Timing::DispatchMoveFocus);
 	int workspace = workspace_for_action();
 	if (workspace < 0) return;
 
@@ -79,7 +90,141 @@ void dispatch_movefocus(std::string arg) {
 	}
 }
 
+void dispatch_movetoworkspace(std::string value) {
+	stats::Timer timer(stats::Timing::DispatchMoveToWorkspace);
+	int origin = workspace_for_action();
+	if (origin < 0) return;
+
+	auto args = CVarList(value);
+
+	std::string name;
+	int target = getWorkspaceIDFromString(args[0], name);
+	if (target == INT_MAX) {
+		Debug::log(ERR, "hy3:movetoworkspace: invalid workspace %s", args[0].c_str());
+		return;
+	}
+
+	if (g_pCompositor->getWorkspaceByID(target) == nullptr) {
+		g_pCompositor->createNewWorkspace(target, g_pCompositor->m_pLastMonitor->ID, name);
+	}
+
+	g_Hy3Layout->moveToWorkspace(origin, target, args[1] == "follow");
+}
+
+void dispatch_undo(std::string arg) {
+	stats::Timer timer(stats::Timing::DispatchUndo);
+	int workspace = workspace_for_action();
+	if (workspace < 0) return;
+
+	g_Hy3Layout->undo(workspace);
+}
+
+void dispatch_redo(std::string arg) {
+	stats::Timer timer(stats::Timing::DispatchRedo);
+	int workspace = workspace_for_action();
+	if (workspace < 0) return;
+
+	g_Hy3Layout->redo(workspace);
+}
+
+void dispatch_template(std::string value) {
+	stats::Timer timer(stats::Timing::DispatchTemplate);
+
+	// only the workspace is split off, the template is passed on as is
+	auto separator = value.find(',');
+	auto workspace_arg = removeBeginEndSpacesTabs(value.substr(0, separator));
+	auto spec = separator == std::string::npos ? "" : removeBeginEndSpacesTabs(value.substr(separator + 1));
+
+	std::string name;
+	int workspace = getWorkspaceIDFromString(workspace_arg, name);
+	if (workspace == INT_MAX) {
+		Debug::log(ERR, "hy3:template: invalid workspace %s", workspace_arg.c_str());
+		return;
+	}
+
+	if (spec == "none") {
+		g_Hy3Layout->clearWorkspaceTemplate(workspace);
+		return;
+	}
+
+	std::string error;
+	if (!g_Hy3Layout->setWorkspaceTemplate(workspace, spec, error)) {
+		Debug::log(ERR, "hy3:template: %s", error.c_str());
+		HyprlandAPI::addNotification(PHANDLE, "[hy3] invalid template: " + error, CColor(1.0, 0.2, 0.2, 1.0), 5000);
+	}
+}
+
+// parse a single `<name> [args...]` step of hy3:batch, arguments may be separated by spaces or commas
+bool parseBatchStep(std::string value, Hy3BatchStep& step, std::string& error) {
+	std::replace(value.begin(), value.end(), ',', ' ');
+	std::istringstream stream(value);
+	std::vector<std::string> args;
+	for (std::string arg; stream >> arg;) args.push_back(arg);
+
+	if (args.empty()) {
+		error = "empty step";
+		return false;
+	}
+
+	auto& name = args[0];
+	args.resize(3);
+
+	if (name == "makegroup") {
+		step.type = Hy3BatchStep::MakeGroup;
+
+		if (args[1] == "h") step.layout = Hy3GroupLayout::SplitH;
+		else if (args[1] == "v") step.layout = Hy3GroupLayout::SplitV;
+		else if (args[1] == "accordion") step.layout = Hy3GroupLayout::Accordion;
+		else if (args[1] == "opposite") step.type = Hy3BatchStep::MakeOppositeGroup;
+		else {
+			error = "invalid makegroup layout '" + args[1] + "'";
+			return false;
+		}
+	} else if (name == "movewindow" || name == "movefocus") {
+		step.type = name == "movewindow" ? Hy3BatchStep::MoveWindow : Hy3BatchStep::MoveFocus;
+		step.once = step.type == Hy3BatchStep::MoveWindow && args[2] == "once";
+
+		auto shift = parseShiftArg(args[1]);
+		if (!shift) {
+			error = "invalid " + name + " direction '" + args[1] + "'";
+			return false;
+		}
+
+		step.direction = shift.value();
+	} else if (name == "raisefocus") {
+		step.type = Hy3BatchStep::RaiseFocus;
+	} else {
+		error = "unknown operation '" + name + "'";
+		return false;
+	}
+
+	return true;
+}
+
+void dispatch_batch(std::string value) {
+	stats::Timer timer(stats::Timing::DispatchBatch);
+	int workspace = workspace_for_action();
+	if (workspace < 0) return;
+
+	// everything is parsed before the first step runs
+	std::vector<Hy3BatchStep> steps;
+	std::string error;
+
+	auto parts = CVarList(value, 0, ';');
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (!parseBatchStep(parts[i], steps.emplace_back(), error)) break;
+	}
+
+	if (error.empty()) g_Hy3Layout->runBatch(workspace, steps, error);
+
+	if (!error.empty()) {
+		Debug::log(ERR, "hy3:batch: %s", error.c_str());
+		HyprlandAPI::addNotification(PHANDLE, "[hy3] batch failed: " + error, CColor(1.0, 0.2, 0.2, 1.0), 5000);
+	}
+}
+
 void dispatch_raisefocus(std::string arg) {
+	stats::Timer timer(stats::Timing::DispatchRaiseFocus);
 	int workspace = workspace_for_action();
 	if (workspace < 0) return;
 
@@ -87,6 +232,7 @@ void dispatch_raisefocus(std::string arg) {
 }
 
 void dispatch_debug(std::string arg) {
+	stats::Timer timer(stats::Timing::DispatchDebugNodes);
 	int workspace = workspace_for_action();
 	if (workspace < 0) return;
 
@@ -98,23 +244,78 @@ void dispatch_debug(std::string arg) {
 	}
 }
 
+void dispatch_stats(std::string arg) {
+	Debug::log(LOG, "HY3 STATS\n%s", stats::dump().c_str());
+
+	if (arg == "reset") {
+		stats::reset();
+	}
+}
+
+void dispatch_trace(std::string value) {
+	auto args = CVarList(value);
+
+	if (args[0] == "start") {
+		trace::start();
+	} else if (args[0] == "stop") {
+		trace::stop();
+	} else if (args[0] == "dump") {
+		auto path = args[1].empty() ? "/tmp/hy3-trace-" + std::to_string(getpid()) + ".json" : args[1];
+
+		if (trace::dump(path)) {
+			Debug::log(LOG, "hy3: wrote trace to %s", path.c_str());
+		} else {
+			Debug::log(ERR, "hy3: failed to write trace to %s", path.c_str());
+		}
+	}
+}
+
 APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	PHANDLE = handle;
 
-	selection_hook::init();
+	tree_snapshot::init();
 
 	HyprlandAPI::addConfigValue(PHANDLE, "plugin:hy3:no_gaps_when_only", SConfigValue{.intValue = 0});
+	HyprlandAPI::addConfigValue(PHANDLE, "plugin:hy3:accordion_collapsed_size", SConfigValue{.intValue = 60});
+	HyprlandAPI::addConfigValue(PHANDLE, "plugin:hy3:history_size", SConfigValue{.intValue = 32});
+	HyprlandAPI::addConfigValue(PHANDLE, "plugin:hy3:transaction_timeout", SConfigValue{.intValue = 200});
 
 	g_Hy3Layout = std::make_unique<Hy3Layout>();
 	HyprlandAPI::addLayout(PHANDLE, "hy3", g_Hy3Layout.get());
 
+	// the workspace event fires as the switch animation starts, before the workspace is rendered
+	HyprlandAPI::registerCallbackDynamic(PHANDLE, "workspace", [](void*, std::any data) {
+		if (g_pLayoutManager->getCurrentLayout() != g_Hy3Layout.get()) return;
+
+		auto* workspace = std::any_cast<CWorkspace*>(data);
+		g_Hy3Layout->wakeWorkspace(workspace->m_iID);
+	});
+
+	// also tracked while another layout is active, so the dormant tree knows which windows are gone
+	HyprlandAPI::registerCallbackDynamic(PHANDLE, "closeWindow", [](void*, std::any data) {
+		g_Hy3Layout->onWindowClosed(std::any_cast<CWindow*>(data));
+	});
+
+	HyprlandAPI::registerCallbackDynamic(PHANDLE, "destroyWorkspace", [](void*, std::any data) {
+		g_Hy3Layout->onWorkspaceDestroyed(std::any_cast<CWorkspace*>(data)->m_iID);
+	});
+
 	HyprlandAPI::addDispatcher(PHANDLE, "hy3:makegroup", dispatch_makegroup);
 	HyprlandAPI::addDispatcher(PHANDLE, "hy3:movefocus", dispatch_movefocus);
 	HyprlandAPI::addDispatcher(PHANDLE, "hy3:movewindow", dispatch_movewindow);
 	HyprlandAPI::addDispatcher(PHANDLE, "hy3:raisefocus", dispatch_raisefocus);
+	HyprlandAPI::addDispatcher(PHANDLE, "hy3:movetoworkspace", dispatch_movetoworkspace);
+	HyprlandAPI::addDispatcher(PHANDLE, "hy3:undo", dispatch_undo);
+	HyprlandAPI::addDispatcher(PHANDLE, "hy3:redo", dispatch_redo);
+	HyprlandAPI::addDispatcher(PHANDLE, "hy3:template", dispatch_template);
+	HyprlandAPI::addDispatcher(PHANDLE, "hy3:batch", dispatch_batch);
 	HyprlandAPI::addDispatcher(PHANDLE, "hy3:debugnodes", dispatch_debug);
+	HyprlandAPI::addDispatcher(PHANDLE, "hy3:stats", dispatch_stats);
+	HyprlandAPI::addDispatcher(PHANDLE, "hy3:trace", dispatch_trace);
 
 	return {"hy3", "i3 like layout for hyprland", "outfoxxed", "0.1"};
 }
 
-APICALL EXPORT void PLUGIN_EXIT() {}
+APICALL EXPORT void PLUGIN_EXIT() {
+	tree_snapshot::deinit();
+}